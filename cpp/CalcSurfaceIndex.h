@@ -0,0 +1,338 @@
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <vector>
+
+// values interpolate() transfers
+enum class interpolation_mode : u32
+{
+    illuminance = 0, // vl, vd (vs = vl + vd)
+    colors = 1,      // c, cg
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// CalcSurfaceIndex
+// Uniform grid over the triangles of a calc surface (Geometry::setTriangles).
+// Transfers calc results to arbitrary (denser) render vertices by barycentric
+// interpolation on the closest calc triangle.
+class CalcSurfaceIndex
+{
+    const Geometry *m_calc = nullptr;
+
+    vec3f m_min;
+    vec3f m_cell; // cell size
+    u32 m_dims[3] = {0, 0, 0};
+
+    std::vector<u32> m_cell_start; // CSR: triangles of cell i are m_cell_tris[m_cell_start[i] .. m_cell_start[i + 1])
+    std::vector<u32> m_cell_tris;
+
+public:
+    // cell_tris - average number of triangles per cell
+    bool build(const Geometry &calc, float cell_tris = 2.0f)
+    {
+        m_calc = &calc;
+        m_cell_start.clear();
+        m_cell_tris.clear();
+
+        u32 t_count = calc.getTrianglesCount();
+        if (!t_count)
+            return false;
+
+        const u32 *idx = calc.getTriangles();
+
+        vec3f mn(FLT_MAX, FLT_MAX, FLT_MAX);
+        vec3f mx(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+        for (u32 i = 0; i < calc.getPointsCount(); ++i)
+        {
+            const vec3f &p = calc[i]->p;
+            mn.set(std::min(mn.x, p.x), std::min(mn.y, p.y), std::min(mn.z, p.z));
+            mx.set(std::max(mx.x, p.x), std::max(mx.y, p.y), std::max(mx.z, p.z));
+        }
+
+        // cells of equal size on non-degenerate axes, flat axes get one cell
+        vec3f ext = mx - mn;
+        float e[3] = {ext.x, ext.y, ext.z};
+        float max_e = std::max(e[0], std::max(e[1], e[2]));
+        float eps = std::max(max_e * 1e-4f, 1e-6f);
+
+        u32 flat = 0;
+        float volume = 1.0f;
+        for (u32 a = 0; a < 3; ++a)
+        {
+            if (e[a] <= eps)
+                ++flat;
+            else
+                volume *= e[a];
+        }
+        u32 live = 3 - flat;
+        float cells = std::max(1.0f, t_count / cell_tris);
+        float size = live ? std::pow(volume / cells, 1.0f / live) : 1.0f;
+
+        for (u32 a = 0; a < 3; ++a)
+        {
+            m_dims[a] = (e[a] <= eps) ? 1 : std::min(1024u, std::max(1u, u32(e[a] / size)));
+            e[a] = std::max(e[a], eps);
+        }
+        m_min = mn;
+        m_cell.set(e[0] / m_dims[0], e[1] / m_dims[1], e[2] / m_dims[2]);
+
+        u32 cells_count = m_dims[0] * m_dims[1] * m_dims[2];
+        m_cell_start.assign(cells_count + 1, 0);
+
+        // two passes: count, then fill
+        for (u32 pass = 0; pass < 2; ++pass)
+        {
+            std::vector<u32> fill;
+            if (pass)
+            {
+                for (u32 i = 0; i < cells_count; ++i)
+                    m_cell_start[i + 1] += m_cell_start[i];
+                m_cell_tris.resize(m_cell_start[cells_count]);
+                fill.assign(m_cell_start.begin(), m_cell_start.end() - 1);
+            }
+
+            for (u32 t = 0; t < t_count; ++t)
+            {
+                u32 lo[3], hi[3];
+                triangleCells(idx + 3 * t, lo, hi);
+                for (u32 z = lo[2]; z <= hi[2]; ++z)
+                    for (u32 y = lo[1]; y <= hi[1]; ++y)
+                        for (u32 x = lo[0]; x <= hi[0]; ++x)
+                        {
+                            u32 c = cellIndex(x, y, z);
+                            if (pass)
+                                m_cell_tris[fill[c]++] = t;
+                            else
+                                ++m_cell_start[c + 1];
+                        }
+            }
+        }
+        return true;
+    }
+
+    bool isEmpty() const { return m_cell_tris.empty(); }
+
+    // closest calc triangle to q
+    // tri - triangle index, w - barycentric weights of the closest point
+    bool closest(const vec3f &q, u32 &tri, float w[3]) const
+    {
+        if (isEmpty())
+            return false;
+
+        const u32 *idx = m_calc->getTriangles();
+
+        int c[3];
+        cellOf(q, c);
+
+        float best = FLT_MAX;
+        int max_r = int(std::max(m_dims[0], std::max(m_dims[1], m_dims[2])));
+
+        for (int r = 0; r <= max_r; ++r)
+        {
+            for (int z = c[2] - r; z <= c[2] + r; ++z)
+            {
+                if (z < 0 || z >= int(m_dims[2]))
+                    continue;
+                for (int y = c[1] - r; y <= c[1] + r; ++y)
+                {
+                    if (y < 0 || y >= int(m_dims[1]))
+                        continue;
+                    bool shell_yz = (std::abs(z - c[2]) == r || std::abs(y - c[1]) == r);
+                    for (int x = c[0] - r; x <= c[0] + r; x += (shell_yz ? 1 : std::max(1, 2 * r)))
+                    {
+                        if (x < 0 || x >= int(m_dims[0]))
+                            continue;
+
+                        u32 cell = cellIndex(x, y, z);
+                        for (u32 i = m_cell_start[cell]; i < m_cell_start[cell + 1]; ++i)
+                        {
+                            u32 t = m_cell_tris[i];
+                            const u32 *v = idx + 3 * t;
+                            float tw[3];
+                            float d = closestOnTriangle(q, (*m_calc)[v[0]]->p, (*m_calc)[v[1]]->p, (*m_calc)[v[2]]->p, tw);
+                            if (d < best)
+                            {
+                                best = d;
+                                tri = t;
+                                w[0] = tw[0];
+                                w[1] = tw[1];
+                                w[2] = tw[2];
+                            }
+                        }
+                    }
+                }
+            }
+
+            // every triangle not seen yet lies outside the searched block of cells
+            float bound = blockDistance(q, c, r);
+            if (best < FLT_MAX && best <= bound * bound)
+                break;
+        }
+        return best < FLT_MAX;
+    }
+
+    // interpolate calc results onto count render vertices (positions in out[i].p)
+    void interpolate(vertex *out, u32 count, interpolation_mode mode = interpolation_mode::illuminance) const
+    {
+        if (isEmpty())
+            return;
+
+        const u32 *idx = m_calc->getTriangles();
+        const Geometry &calc = *m_calc;
+
+        parallel_utils::parallel_for(0, count, 1024, [&](u32 begin, u32 end)
+        {
+            for (u32 i = begin; i < end; ++i)
+            {
+                vertex &v = out[i];
+                u32 t;
+                float w[3];
+                if (!closest(v.p, t, w))
+                    continue;
+
+                const vertex &a = *calc[idx[3 * t]];
+                const vertex &b = *calc[idx[3 * t + 1]];
+                const vertex &c = *calc[idx[3 * t + 2]];
+
+                if (mode == interpolation_mode::colors)
+                {
+                    v.c = lerp3(a.c, b.c, c.c, w);
+                    v.cg = lerp3(a.cg, b.cg, c.cg, w);
+                }
+                else
+                {
+                    v.vl = lerp3(a.vl, b.vl, c.vl, w);
+                    v.vd = lerp3(a.vd, b.vd, c.vd, w);
+                    v.vs = v.vl + v.vd;
+                }
+            }
+        });
+    }
+
+    void interpolate(Geometry &render, interpolation_mode mode = interpolation_mode::illuminance) const
+    {
+        if (render.getPointsCount())
+            interpolate(render[0], render.getPointsCount(), mode);
+    }
+
+private:
+    static color3f lerp3(const color3f &a, const color3f &b, const color3f &c, const float w[3])
+    {
+        return color3f(a.r * w[0] + b.r * w[1] + c.r * w[2],
+                       a.g * w[0] + b.g * w[1] + c.g * w[2],
+                       a.b * w[0] + b.b * w[1] + c.b * w[2]);
+    }
+
+    u32 cellIndex(u32 x, u32 y, u32 z) const
+    {
+        return (z * m_dims[1] + y) * m_dims[0] + x;
+    }
+
+    void cellOf(const vec3f &p, int c[3]) const
+    {
+        float d[3] = {(p.x - m_min.x) / m_cell.x, (p.y - m_min.y) / m_cell.y, (p.z - m_min.z) / m_cell.z};
+        for (u32 a = 0; a < 3; ++a)
+        {
+            c[a] = std::min(int(m_dims[a]) - 1, std::max(0, int(std::floor(d[a]))));
+        }
+    }
+
+    // distance from q to the nearest side of block [c - r, c + r] that does not touch the grid border
+    float blockDistance(const vec3f &q, const int c[3], int r) const
+    {
+        const float *p = &q.x;
+        const float *mn = &m_min.x;
+        const float *cell = &m_cell.x;
+
+        float d = FLT_MAX;
+        for (u32 a = 0; a < 3; ++a)
+        {
+            if (c[a] - r > 0)
+                d = std::min(d, p[a] - (mn[a] + (c[a] - r) * cell[a]));
+            if (c[a] + r + 1 < int(m_dims[a]))
+                d = std::min(d, (mn[a] + (c[a] + r + 1) * cell[a]) - p[a]);
+        }
+        return std::max(d, 0.0f);
+    }
+
+    void triangleCells(const u32 *v, u32 lo[3], u32 hi[3]) const
+    {
+        int a[3], b[3];
+        cellOf((*m_calc)[v[0]]->p, a);
+        for (u32 k = 0; k < 3; ++k)
+            lo[k] = hi[k] = a[k];
+
+        for (u32 j = 1; j < 3; ++j)
+        {
+            cellOf((*m_calc)[v[j]]->p, b);
+            for (u32 k = 0; k < 3; ++k)
+            {
+                lo[k] = std::min(lo[k], u32(b[k]));
+                hi[k] = std::max(hi[k], u32(b[k]));
+            }
+        }
+    }
+
+    // squared distance from p to triangle abc, w - barycentric of the closest point
+    // (Ericson, Real-Time Collision Detection, 5.1.5)
+    static float closestOnTriangle(const vec3f &p, const vec3f &a, const vec3f &b, const vec3f &c, float w[3])
+    {
+        vec3f ab = b - a;
+        vec3f ac = c - a;
+        vec3f ap = p - a;
+
+        float d1 = ab.dot(ap);
+        float d2 = ac.dot(ap);
+        if (d1 <= 0.0f && d2 <= 0.0f)
+            return setBary(p, a, b, c, w, 1.0f, 0.0f, 0.0f);
+
+        vec3f bp = p - b;
+        float d3 = ab.dot(bp);
+        float d4 = ac.dot(bp);
+        if (d3 >= 0.0f && d4 <= d3)
+            return setBary(p, a, b, c, w, 0.0f, 1.0f, 0.0f);
+
+        float vc = d1 * d4 - d3 * d2;
+        if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+        {
+            float v = d1 / (d1 - d3);
+            return setBary(p, a, b, c, w, 1.0f - v, v, 0.0f);
+        }
+
+        vec3f cp = p - c;
+        float d5 = ab.dot(cp);
+        float d6 = ac.dot(cp);
+        if (d6 >= 0.0f && d5 <= d6)
+            return setBary(p, a, b, c, w, 0.0f, 0.0f, 1.0f);
+
+        float vb = d5 * d2 - d1 * d6;
+        if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+        {
+            float v = d2 / (d2 - d6);
+            return setBary(p, a, b, c, w, 1.0f - v, 0.0f, v);
+        }
+
+        float va = d3 * d6 - d5 * d4;
+        if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+        {
+            float v = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+            return setBary(p, a, b, c, w, 0.0f, 1.0f - v, v);
+        }
+
+        float denom = 1.0f / (va + vb + vc);
+        float v = vb * denom;
+        float u = vc * denom;
+        return setBary(p, a, b, c, w, 1.0f - v - u, v, u);
+    }
+
+    static float setBary(const vec3f &p, const vec3f &a, const vec3f &b, const vec3f &c, float w[3], float wa, float wb, float wc)
+    {
+        w[0] = wa;
+        w[1] = wb;
+        w[2] = wc;
+        vec3f q = a * wa + b * wb + c * wc;
+        vec3f d = p - q;
+        return d.dot(d);
+    }
+};
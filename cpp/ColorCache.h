@@ -0,0 +1,463 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// bump when PuryaMesh::colorPoint changes (normalization operator, tone curve)
+static const u32 color_operator_version = 1;
+
+// cache file: color_cache_header + color_cache_record[count]
+static const u32 color_cache_magic = 0x43434d44; // "DMCC"
+static const u32 color_cache_version = 1;
+
+struct color_cache_header
+{
+    u32 magic = color_cache_magic;
+    u32 version = color_cache_version;
+    u32 count = 0;
+    u32 reserved = 0;
+    u64 key = 0;
+};
+
+// packed PuryaMesh::colorPoint result, cg is gray
+struct color_cache_record
+{
+    float c[3]; ///< luminance color (sRGB)
+    float cg;   ///< illuminance color (sRGB)
+};
+
+static_assert(sizeof(color_cache_header) == 24 && sizeof(color_cache_record) == 16, "color cache file layout");
+
+namespace cache_utils
+{
+    // streaming 64-bit hash of 8-byte words (not cryptographic)
+    struct hasher
+    {
+        u64 h;
+
+        explicit hasher(u64 seed = 0x9e3779b97f4a7c15ull) : h(seed) {}
+
+        void add(u64 w)
+        {
+            w *= 0xbf58476d1ce4e5b9ull;
+            w ^= w >> 31;
+            h = (h ^ w) * 0x94d049bb133111ebull;
+            h ^= h >> 29;
+        }
+
+        void add(float a, float b)
+        {
+            u32 x, y;
+            memcpy(&x, &a, 4);
+            memcpy(&y, &b, 4);
+            add(u64(x) | (u64(y) << 32));
+        }
+
+        void add(const color3f &c, float w)
+        {
+            add(c.r, c.g);
+            add(c.b, w);
+        }
+
+        u64 get() const
+        {
+            u64 r = h ^ (h >> 32);
+            return r ? r : 1; // 0 - no key
+        }
+    };
+
+    // read-only memory mapping of a whole file
+    class mapped_file
+    {
+        const u8 *m_data = nullptr;
+        size_t m_size = 0;
+#ifdef _WIN32
+        HANDLE m_file = INVALID_HANDLE_VALUE;
+        HANDLE m_mapping = nullptr;
+#endif
+
+    public:
+        mapped_file() {}
+        ~mapped_file() { close(); }
+
+        mapped_file(const mapped_file &) = delete;
+        mapped_file &operator=(const mapped_file &) = delete;
+
+        bool open(const std::string &path)
+        {
+            close();
+#ifdef _WIN32
+            m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (m_file == INVALID_HANDLE_VALUE)
+                return false;
+
+            LARGE_INTEGER size;
+            if (!GetFileSizeEx(m_file, &size) || !size.QuadPart)
+                return close(), false;
+
+            m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (!m_mapping)
+                return close(), false;
+
+            m_data = static_cast<const u8 *>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+            if (!m_data)
+                return close(), false;
+            m_size = size_t(size.QuadPart);
+#else
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                return false;
+
+            struct stat st;
+            if (fstat(fd, &st) || !st.st_size)
+            {
+                ::close(fd);
+                return false;
+            }
+
+            void *p = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd); // the mapping keeps the file
+            if (p == MAP_FAILED)
+                return false;
+
+            m_data = static_cast<const u8 *>(p);
+            m_size = size_t(st.st_size);
+#endif
+            return true;
+        }
+
+        void close()
+        {
+#ifdef _WIN32
+            if (m_data)
+                UnmapViewOfFile(m_data);
+            if (m_mapping)
+                CloseHandle(m_mapping);
+            if (m_file != INVALID_HANDLE_VALUE)
+                CloseHandle(m_file);
+            m_mapping = nullptr;
+            m_file = INVALID_HANDLE_VALUE;
+#else
+            if (m_data)
+                munmap(const_cast<u8 *>(m_data), m_size);
+#endif
+            m_data = nullptr;
+            m_size = 0;
+        }
+
+        const u8 *data() const { return m_data; }
+        size_t size() const { return m_size; }
+    };
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// ColorCache
+// On-disk cache of PuryaMesh::normalizeColor results.
+// A file is named by the hash of everything the colors depend on (vl / vd of every point, diffuse
+// spectrum, normalization constants, operator version), so unchanged meshes are read back from a
+// mapped file instead of being recolored. Least recently used files are removed above max_bytes.
+// Sizes and use order of the files are kept in memory (the directory is scanned once), files written
+// by other processes meanwhile are picked up when they are hit.
+class ColorCache
+{
+    struct file_info
+    {
+        u64 size;
+        u64 used; // m_clock of the last store / hit
+    };
+
+    std::filesystem::path m_dir;
+    u64 m_max_bytes;
+    u32 m_hits = 0;
+    u32 m_misses = 0;
+
+    std::unordered_map<u64, file_info> m_files; // by key
+    u64 m_total = 0;
+    u64 m_clock = 0;
+    bool m_scanned = false;
+
+    static bool fail(const char *msg, const std::string &path)
+    {
+        fprintf(stderr, "color cache: %s %s\n", msg, path.c_str());
+        return false;
+    }
+
+    // index of the files already in the directory, oldest first
+    void scan()
+    {
+        if (m_scanned)
+            return;
+        m_scanned = true;
+
+        struct file
+        {
+            u64 key;
+            std::filesystem::file_time_type time;
+            u64 size;
+        };
+
+        std::error_code ec;
+        std::vector<file> files;
+        for (std::filesystem::directory_iterator it(m_dir, ec), end; !ec && it != end; it.increment(ec))
+        {
+            const std::filesystem::path &p = it->path();
+            if (p.extension() != ".dmc")
+                continue;
+
+            std::error_code fec;
+            file f{std::strtoull(p.stem().string().c_str(), nullptr, 16), it->last_write_time(fec), u64(it->file_size(fec))};
+            if (!fec && f.key)
+                files.push_back(f);
+        }
+
+        std::sort(files.begin(), files.end(), [](const file &a, const file &b) { return a.time < b.time; });
+        for (const file &f : files)
+            touch(f.key, f.size);
+    }
+
+    // key was stored / hit now
+    void touch(u64 key, u64 size)
+    {
+        file_info &f = m_files[key];
+        m_total += size - f.size; // f.size = 0 for new keys
+        f.size = size;
+        f.used = ++m_clock;
+    }
+
+    // removes least recently used files until the cache fits into bytes
+    void evict(u64 bytes)
+    {
+        if (m_total <= bytes)
+            return;
+
+        std::vector<std::pair<u64, u64>> order; // used, key
+        order.reserve(m_files.size());
+        for (const auto &f : m_files)
+            order.emplace_back(f.second.used, f.first);
+        std::sort(order.begin(), order.end());
+
+        std::error_code ec;
+        for (const auto &f : order)
+        {
+            if (m_total <= bytes)
+                break;
+            // fails for files mapped on windows, they stay indexed and are removed later
+            if (!std::filesystem::remove(path(f.second), ec) && ec)
+                continue;
+            m_total -= m_files[f.second].size;
+            m_files.erase(f.second);
+        }
+    }
+
+    // unique per process and call, concurrent stores of one key do not share a temporary file
+    static std::string tempSuffix()
+    {
+        static std::atomic<u32> counter{0};
+#ifdef _WIN32
+        unsigned long long pid = _getpid();
+#else
+        unsigned long long pid = getpid();
+#endif
+        char name[48];
+        snprintf(name, sizeof(name), ".%llx.%x.tmp", pid, counter.fetch_add(1));
+        return name;
+    }
+
+public:
+    // after max_bytes is exceeded, files are removed until the cache is this fraction of it,
+    // so eviction runs once per several stores
+    float evict_to = 0.9f;
+
+    // dir - cache directory (created on demand), max_bytes - size limit of all cache files
+    explicit ColorCache(const std::string &dir, u64 max_bytes = u64(1) << 30)
+        : m_dir(dir), m_max_bytes(max_bytes)
+    {
+    }
+
+    static u64 key(PuryaMesh &mesh)
+    {
+        const Geometry &geom = *mesh.getGeometry();
+        u32 count = geom.getPointsCount();
+
+        cache_utils::hasher h;
+        h.add(u64(color_operator_version) << 32 | count);
+        h.add(geom.getMaterial().getDiffuseSpectrumColor(), L_MAX);
+        h.add(IL_MAX, IL_POW);
+        for (u32 i = 0; i < count; ++i)
+        {
+            const vertex &v = *geom[i];
+            h.add(v.vl, v.vd.r);
+            h.add(v.vd.g, v.vd.b);
+        }
+        return h.get();
+    }
+
+    std::string path(u64 key) const
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.dmc", (unsigned long long)key);
+        return (m_dir / name).string();
+    }
+
+    // maps the file of key, returns its records (valid while file is open) or nullptr
+    const color_cache_record *find(u64 key, u32 count, cache_utils::mapped_file &file)
+    {
+        std::string p = path(key);
+        if (!file.open(p))
+            return nullptr;
+
+        const color_cache_header *h = reinterpret_cast<const color_cache_header *>(file.data());
+        if (file.size() != sizeof(color_cache_header) + size_t(count) * sizeof(color_cache_record) || h->magic != color_cache_magic ||
+            h->version != color_cache_version || h->key != key || h->count != count)
+        {
+            file.close();
+            fail("invalid file", p);
+            return nullptr;
+        }
+
+        // least recently used order for eviction (on disk for the next session)
+        scan();
+        touch(key, file.size());
+        std::error_code ec;
+        std::filesystem::last_write_time(p, std::filesystem::file_time_type::clock::now(), ec);
+        return reinterpret_cast<const color_cache_record *>(file.data() + sizeof(color_cache_header));
+    }
+
+    // fills c / cg of the mesh points from the cache
+    bool load(PuryaMesh &mesh, u64 key)
+    {
+        Geometry &geom = *mesh.getGeometry();
+        u32 count = geom.getPointsCount();
+
+        cache_utils::mapped_file file;
+        const color_cache_record *r = find(key, count, file);
+        if (!r)
+        {
+            ++m_misses;
+            return false;
+        }
+
+        for (u32 i = 0; i < count; ++i, ++r)
+        {
+            vertex &v = *geom[i];
+            v.c.set(r->c[0], r->c[1], r->c[2]);
+            v.cg.set(r->cg);
+        }
+        ++m_hits;
+        return true;
+    }
+
+    // writes c / cg of the mesh points (written to a temporary file and renamed, readers never see a partial file)
+    bool store(PuryaMesh &mesh, u64 key)
+    {
+        const Geometry &geom = *mesh.getGeometry();
+        u32 count = geom.getPointsCount();
+
+        std::error_code ec;
+        std::filesystem::create_directories(m_dir, ec);
+
+        std::string p = path(key);
+        std::string tmp = p + tempSuffix();
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            if (!out)
+                return fail("cannot write", tmp);
+
+            color_cache_header h;
+            h.count = count;
+            h.key = key;
+            out.write(reinterpret_cast<const char *>(&h), sizeof(h));
+
+            std::vector<color_cache_record> block;
+            block.reserve(std::min<u32>(count, 65536));
+            for (u32 i = 0; i < count; ++i)
+            {
+                const vertex &v = *geom[i];
+                block.push_back({{v.c.r, v.c.g, v.c.b}, v.cg.r});
+                if (block.size() == block.capacity() || i + 1 == count)
+                {
+                    out.write(reinterpret_cast<const char *>(block.data()), std::streamsize(block.size() * sizeof(color_cache_record)));
+                    block.clear();
+                }
+            }
+            if (!out)
+            {
+                out.close();
+                std::filesystem::remove(tmp, ec);
+                return fail("cannot write", tmp);
+            }
+        }
+
+        std::filesystem::rename(tmp, p, ec);
+        if (ec)
+        {
+            std::filesystem::remove(tmp, ec);
+            return fail("cannot rename", tmp);
+        }
+
+        scan();
+        touch(key, sizeof(color_cache_header) + u64(count) * sizeof(color_cache_record));
+        if (m_total > m_max_bytes)
+            evict(u64(double(m_max_bytes) * evict_to));
+        return true;
+    }
+
+    // cached normalizeColor: mapped file read if the inputs did not change, recolor + store otherwise
+    bool normalizeColor(PuryaMesh &mesh)
+    {
+        if (!mesh.getGeometry()->getPointsCount())
+            return false;
+
+        u64 k = key(mesh);
+        if (load(mesh, k))
+            return true;
+
+        if (!mesh.normalizeColor())
+            return false;
+        store(mesh, k);
+        return true;
+    }
+
+    // removes least recently used files until the cache fits into max_bytes
+    void evict()
+    {
+        scan();
+        evict(m_max_bytes);
+    }
+
+    // cached bytes (files of this directory known to this instance)
+    u64 getSize() const { return m_total; }
+
+    void clear()
+    {
+        scan();
+        evict(0);
+    }
+
+    u32 getHits() const { return m_hits; }
+    u32 getMisses() const { return m_misses; }
+};
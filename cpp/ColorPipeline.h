@@ -0,0 +1,144 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// part of the solver output: count calc points of one mesh starting at point first
+struct color_chunk
+{
+    u32 mesh = 0;
+    u32 first = 0;
+    color3f cd;              ///< diffuse spectrum of the mesh material
+    std::vector<color3f> vl; ///< direct illuminance [lx]
+    std::vector<color3f> vd; ///< diffuse illuminance [lx]
+    std::vector<color4f> c;  ///< out: luminance color (sRGB)
+    std::vector<color4f> cg; ///< out: illuminance color (sRGB, gray)
+
+    u32 size() const { return u32(vl.size()); }
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// ColorPipeline
+// Colors solver output while the solver is still running.
+// push() hands a chunk to the pipeline, workers color chunks as they arrive and the sink receives
+// finished chunks on one thread in push order. push() blocks while capacity chunks are in flight,
+// so a slow sink slows the solver down instead of growing the queue.
+class ColorPipeline
+{
+    typedef std::function<void(const color_chunk &)> sink_t;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::unique_ptr<color_chunk> m_next; // pushed, not yet taken by the pipeline
+    bool m_closed = false;
+    std::thread m_thread;
+
+    // blocks until a chunk is pushed, false after finish()
+    bool take(color_chunk &chunk)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [this]() { return m_next || m_closed; });
+        if (!m_next)
+            return false;
+
+        chunk = std::move(*m_next);
+        m_next.reset();
+        m_cv.notify_all();
+        return true;
+    }
+
+public:
+    // sink - called for every colored chunk, in push order, on the pipeline writer thread
+    // workers, capacity - see parallel_utils::ordered_pipeline
+    explicit ColorPipeline(sink_t sink, u32 workers = 0, u32 capacity = 0)
+    {
+        m_thread = std::thread([this, sink, workers, capacity]()
+        {
+            parallel_utils::ordered_pipeline<color_chunk>(
+                [this](color_chunk &chunk) { return take(chunk); },
+                [](color_chunk &chunk) { color(chunk); },
+                [&sink](color_chunk &chunk) { sink(chunk); },
+                workers, capacity);
+        });
+    }
+
+    ~ColorPipeline()
+    {
+        finish();
+    }
+
+    ColorPipeline(const ColorPipeline &) = delete;
+    ColorPipeline &operator=(const ColorPipeline &) = delete;
+
+    static void color(color_chunk &chunk)
+    {
+        u32 count = chunk.size();
+        assert(chunk.vd.empty() || chunk.vd.size() == count);
+
+        chunk.c.resize(count);
+        chunk.cg.resize(count);
+        for (u32 i = 0; i < count; ++i)
+        {
+            color3f vs = chunk.vd.empty() ? chunk.vl[i] : chunk.vl[i] + chunk.vd[i];
+            PuryaMesh::colorPoint(vs, chunk.cd, chunk.c[i], chunk.cg[i]);
+        }
+    }
+
+    // blocks while the pipeline is full
+    void push(color_chunk &&chunk)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        assert(!m_closed);
+        m_cv.wait(lock, [this]() { return !m_next; });
+        m_next.reset(new color_chunk(std::move(chunk)));
+        m_cv.notify_all();
+    }
+
+    // vl, vd - count points of the mesh starting at first (vd may be nullptr)
+    void push(u32 mesh, u32 first, const Material &mtl, const color3f *vl, const color3f *vd, u32 count)
+    {
+        color_chunk chunk;
+        chunk.mesh = mesh;
+        chunk.first = first;
+        chunk.cd = mtl.getDiffuseSpectrumColor();
+        chunk.vl.assign(vl, vl + count);
+        if (vd)
+            chunk.vd.assign(vd, vd + count);
+        push(std::move(chunk));
+    }
+
+    // waits until every pushed chunk reached the sink, push() is not allowed afterwards
+    void finish()
+    {
+        if (!m_thread.joinable())
+            return;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_closed = true;
+            m_cv.notify_all();
+        }
+        m_thread.join();
+    }
+
+    // sink writing the colors back into the mesh points
+    static sink_t toGeometry(Geometry &geom)
+    {
+        return [&geom](const color_chunk &chunk)
+        {
+            assert(chunk.first + chunk.size() <= geom.getPointsCount());
+            for (u32 i = 0; i < chunk.size(); ++i)
+            {
+                vertex &v = *geom[chunk.first + i];
+                v.vl = chunk.vl[i];
+                if (!chunk.vd.empty())
+                    v.vd = chunk.vd[i];
+                v.c = chunk.c[i];
+                v.cg = chunk.cg[i];
+            }
+        };
+    }
+};
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <memory_resource>
+#include <ostream>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// DaylightSeries
+// Illuminance of the same calc points at many timesteps, dense [timestep][channel][point].
+// normalizeColor colors batches of timesteps in one parallel pass over point blocks,
+// output buffers are reused between batches and handed to a sink (e.g. a file).
+// Optional per-point aggregate: hours with illuminance above a threshold (daylight autonomy).
+class DaylightSeries
+{
+    u32 m_steps = 0;
+    u32 m_points = 0;
+    std::pmr::vector<float> m_E;
+
+    float m_threshold = 0.0f;  ///< [lx], 0 - no aggregate
+    float m_step_hours = 1.0f; ///< duration of one timestep [h]
+    std::pmr::vector<float> m_hours_above;
+
+public:
+    static const u32 block_size = 256; // points per task
+
+    explicit DaylightSeries(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : m_E(resource), m_hours_above(resource)
+    {
+    }
+
+    void create(u32 steps, u32 points)
+    {
+        m_steps = steps;
+        m_points = points;
+        m_E.assign(size_t(steps) * 3 * points, 0.0f);
+        m_hours_above.clear();
+    }
+
+    u32 getStepsCount() const { return m_steps; }
+    u32 getPointsCount() const { return m_points; }
+
+    // channel - 0 (r), 1 (g), 2 (b)
+    float *getPlane(u32 step, u32 channel) { return m_E.data() + (size_t(step) * 3 + channel) * m_points; }
+    const float *getPlane(u32 step, u32 channel) const { return m_E.data() + (size_t(step) * 3 + channel) * m_points; }
+
+    void setIlluminance(u32 step, u32 point, const color3f &E)
+    {
+        assert(step < m_steps && point < m_points);
+        getPlane(step, 0)[point] = E.r;
+        getPlane(step, 1)[point] = E.g;
+        getPlane(step, 2)[point] = E.b;
+    }
+
+    // threshold - illuminance [lx] (gray, vs.sum() / 3), 0 - disable
+    void setThreshold(float threshold, float step_hours = 1.0f)
+    {
+        m_threshold = threshold;
+        m_step_hours = step_hours;
+    }
+
+    // hours above threshold per point, valid after normalizeColor
+    const std::pmr::vector<float> &getHoursAbove() const { return m_hours_above; }
+
+    // sink(step_begin, step_end, c, cg)
+    //   c  - [step][channel][point] sRGB luminance colors of steps [step_begin, step_end)
+    //   cg - [step][point] sRGB illuminance colors (gray)
+    // buffers are valid only during the call
+    template <class Sink>
+    bool normalizeColor(const color3f &cd, Sink sink, u32 batch = 16)
+    {
+        if (!m_steps || !m_points)
+            return false;
+
+        batch = std::max(1u, std::min(batch, m_steps));
+
+        std::vector<float> c(size_t(batch) * 3 * m_points);
+        std::vector<float> cg(size_t(batch) * m_points);
+
+        bool aggregate = m_threshold > 0.0f;
+        if (aggregate)
+            m_hours_above.assign(m_points, 0.0f);
+
+        for (u32 s0 = 0; s0 < m_steps; s0 += batch)
+        {
+            u32 s1 = std::min(s0 + batch, m_steps);
+
+            // each task owns a point block for all steps of the batch: no shared writes
+            parallel_utils::parallel_for(0, m_points, block_size, [&](u32 begin, u32 end)
+            {
+                color4f cl, g;
+                for (u32 s = s0; s < s1; ++s)
+                {
+                    const float *er = getPlane(s, 0);
+                    const float *eg = getPlane(s, 1);
+                    const float *eb = getPlane(s, 2);
+
+                    size_t o = size_t(s - s0);
+                    float *c_r = c.data() + (o * 3 + 0) * m_points;
+                    float *c_g = c.data() + (o * 3 + 1) * m_points;
+                    float *c_b = c.data() + (o * 3 + 2) * m_points;
+                    float *c_gray = cg.data() + o * m_points;
+
+                    for (u32 i = begin; i < end; ++i)
+                    {
+                        color3f vs(er[i], eg[i], eb[i]);
+                        PuryaMesh::colorPoint(vs, cd, cl, g);
+
+                        c_r[i] = cl.r;
+                        c_g[i] = cl.g;
+                        c_b[i] = cl.b;
+                        c_gray[i] = g.r;
+
+                        if (aggregate && vs.sum() / 3.0f >= m_threshold)
+                            m_hours_above[i] += m_step_hours;
+                    }
+                }
+            });
+
+            sink(s0, s1, (const float *)c.data(), (const float *)cg.data());
+        }
+        return true;
+    }
+
+    // binary stream: per batch c [step][channel][point], then cg [step][point] (float32)
+    bool writeColors(std::ostream &out, const color3f &cd, u32 batch = 16)
+    {
+        u32 points = m_points;
+        return normalizeColor(cd, [&](u32 s0, u32 s1, const float *c, const float *cg)
+        {
+            size_t steps = s1 - s0;
+            out.write(reinterpret_cast<const char *>(c), sizeof(float) * steps * 3 * points);
+            out.write(reinterpret_cast<const char *>(cg), sizeof(float) * steps * points);
+        }, batch) && out.good();
+    }
+};
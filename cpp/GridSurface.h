@@ -0,0 +1,181 @@
+#pragma once
+
+#include <memory_resource>
+#include <vector>
+
+enum grid_plane
+{
+    plane_vl_r = 0, // прямая составляющая освещенности
+    plane_vl_g,
+    plane_vl_b,
+    plane_vd_r, // диффузная составляющая освещенности
+    plane_vd_g,
+    plane_vd_b,
+    plane_c_r, // sRGB для картинки яркости
+    plane_c_g,
+    plane_c_b,
+    plane_cg, // sRGB для картинки освещенности (gray)
+    planes_count
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// GridSurface
+// Regular rectangular calc surface. Positions are implicit:
+//   p(i, j) = origin + axis_u * (i * du) + axis_v * (j * dv)
+// Illuminance and colors are dense planes [plane][nv][nu] (see grid_plane),
+// no per-point objects.
+class GridSurface
+{
+    vec3f m_origin;
+    vec3f m_axis_u;
+    vec3f m_axis_v;
+    float m_du = 1.0f;
+    float m_dv = 1.0f;
+    u32 m_nu = 0;
+    u32 m_nv = 0;
+
+    MaterialHandle m_material;
+    std::pmr::vector<float> m_planes;
+
+public:
+    explicit GridSurface(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : m_planes(resource)
+    {
+    }
+
+    // axis_u, axis_v - directions of grid rows / columns (normalized here)
+    void create(const vec3f &origin, const vec3f &axis_u, const vec3f &axis_v, float du, float dv, u32 nu, u32 nv)
+    {
+        m_origin = origin;
+        m_axis_u = axis_u.getNormalize();
+        m_axis_v = axis_v.getNormalize();
+        m_du = du;
+        m_dv = dv;
+        m_nu = nu;
+        m_nv = nv;
+
+        m_planes.assign(size_t(grid_plane::planes_count) * getPointsCount(), 0.0f);
+    }
+
+    void clear()
+    {
+        m_nu = 0;
+        m_nv = 0;
+        m_planes.clear();
+        m_planes.shrink_to_fit();
+    }
+
+    void setMaterial(const Material &mat) { m_material = MaterialHandle(mat); }
+    void setMaterial(const MaterialHandle &mat) { m_material = mat; }
+    const Material &getMaterial() const { return m_material.get(); }
+
+    u32 getCountU() const { return m_nu; }
+    u32 getCountV() const { return m_nv; }
+    u32 getPointsCount() const { return m_nu * m_nv; }
+
+    // bytes used by all planes
+    size_t getMemorySize() const { return m_planes.size() * sizeof(float); }
+
+    vec3f getPosition(u32 i, u32 j) const
+    {
+        return m_origin + m_axis_u * (i * m_du) + m_axis_v * (j * m_dv);
+    }
+
+    vec3f getNormal() const
+    {
+        return m_axis_u.cross(m_axis_v).getNormalize();
+    }
+
+    // plane - grid_plane, row-major [nv][nu]
+    float *getPlane(u32 plane) { return m_planes.data() + size_t(plane) * getPointsCount(); }
+    const float *getPlane(u32 plane) const { return m_planes.data() + size_t(plane) * getPointsCount(); }
+
+    void setIlluminance(u32 i, u32 j, const color3f &vl, const color3f &vd)
+    {
+        size_t k = index(i, j);
+        float *p = m_planes.data();
+        size_t n = getPointsCount();
+        p[grid_plane::plane_vl_r * n + k] = vl.r;
+        p[grid_plane::plane_vl_g * n + k] = vl.g;
+        p[grid_plane::plane_vl_b * n + k] = vl.b;
+        p[grid_plane::plane_vd_r * n + k] = vd.r;
+        p[grid_plane::plane_vd_g * n + k] = vd.g;
+        p[grid_plane::plane_vd_b * n + k] = vd.b;
+    }
+
+    color3f getColor(u32 i, u32 j) const
+    {
+        size_t k = index(i, j);
+        return color3f(getPlane(grid_plane::plane_c_r)[k], getPlane(grid_plane::plane_c_g)[k], getPlane(grid_plane::plane_c_b)[k]);
+    }
+
+    float getColorGray(u32 i, u32 j) const
+    {
+        return getPlane(grid_plane::plane_cg)[index(i, j)];
+    }
+
+    // same result as PuryaMesh::normalizeColor, tiles of tile x tile points run in parallel
+    bool normalizeColor(u32 tile = 64)
+    {
+        if (!getPointsCount())
+            return false;
+
+        color3f cd = getMaterial().getDiffuseSpectrumColor();
+
+        u32 tiles_u = (m_nu + tile - 1) / tile;
+        u32 tiles_v = (m_nv + tile - 1) / tile;
+
+        parallel_utils::parallel_for(0, tiles_u * tiles_v, 1, [&](u32 begin, u32 end)
+        {
+            for (u32 t = begin; t < end; ++t)
+            {
+                u32 i0 = (t % tiles_u) * tile;
+                u32 j0 = (t / tiles_u) * tile;
+                normalizeTile(cd, i0, j0, std::min(i0 + tile, m_nu), std::min(j0 + tile, m_nv));
+            }
+        });
+        return true;
+    }
+
+private:
+    size_t index(u32 i, u32 j) const
+    {
+        assert(i < m_nu && j < m_nv);
+        return size_t(j) * m_nu + i;
+    }
+
+    void normalizeTile(const color3f &cd, u32 i0, u32 j0, u32 i1, u32 j1)
+    {
+        size_t n = getPointsCount();
+        float *p = m_planes.data();
+
+        const float *vlr = p + grid_plane::plane_vl_r * n;
+        const float *vlg = p + grid_plane::plane_vl_g * n;
+        const float *vlb = p + grid_plane::plane_vl_b * n;
+        const float *vdr = p + grid_plane::plane_vd_r * n;
+        const float *vdg = p + grid_plane::plane_vd_g * n;
+        const float *vdb = p + grid_plane::plane_vd_b * n;
+        float *c_red = p + grid_plane::plane_c_r * n;
+        float *c_green = p + grid_plane::plane_c_g * n;
+        float *c_blue = p + grid_plane::plane_c_b * n;
+        float *cgray = p + grid_plane::plane_cg * n;
+
+        color4f c, g;
+        for (u32 j = j0; j < j1; ++j)
+        {
+            size_t row = size_t(j) * m_nu;
+            for (u32 i = i0; i < i1; ++i)
+            {
+                size_t k = row + i;
+                color3f vs(vlr[k] + vdr[k], vlg[k] + vdg[k], vlb[k] + vdb[k]);
+
+                PuryaMesh::colorPoint(vs, cd, c, g);
+
+                c_red[k] = c.r;
+                c_green[k] = c.g;
+                c_blue[k] = c.b;
+                cgray[k] = g.r;
+            }
+        }
+    }
+};
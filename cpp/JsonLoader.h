@@ -0,0 +1,525 @@
+#pragma once
+
+#include <atomic>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#define JSON_SSE2
+#endif
+
+// scene file:
+//   { "materials": [ { "name": "wall", "type": "painted", "color": [r, g, b], "reflection_factor": 0.5,
+//                      "reflection_coating": 0, "transparency": 0, "refractive": 1, "shininess": 0 }, ... ],
+//     "meshes":    [ { "material": 0, "vl": [r, g, b, r, g, b, ...], "vd": [...] }, ... ] }
+// unknown keys are skipped, vd may be missing (zeros)
+struct json_mesh
+{
+    u32 material = 0;
+    size_t offset = 0; ///< first point in json_scene::vl / vd
+    u32 count = 0;
+};
+
+struct json_scene
+{
+    std::vector<std::string> names;
+    std::vector<material_params> params;
+    std::vector<Material> materials;
+    std::vector<json_mesh> meshes;
+    std::vector<float> vl; ///< rgb per point, all meshes back to back
+    std::vector<float> vd;
+
+    void clear()
+    {
+        names.clear();
+        params.clear();
+        materials.clear();
+        meshes.clear();
+        vl.clear();
+        vd.clear();
+    }
+};
+
+namespace json_utils
+{
+    static bool isStructural(char c)
+    {
+        return c == '{' || c == '}' || c == '[' || c == ']' || c == ':' || c == ',' || c == '"';
+    }
+
+    static u32 lowestBit(u32 mask)
+    {
+#ifdef _MSC_VER
+        unsigned long bit;
+        _BitScanForward(&bit, mask);
+        return u32(bit);
+#else
+        return u32(__builtin_ctz(mask));
+#endif
+    }
+
+    // positions of structural characters outside strings (quotes included), stage 1 of the parser.
+    // SSE2 classifies 16 bytes at a time, the string state is a prefix xor over the quote bits;
+    // blocks with backslashes go through the scalar path which handles escapes.
+    // simd = false - scalar path only (reference for the SSE2 path)
+    static bool structuralIndex(const char *data, size_t size, std::vector<u32> &index, bool simd = true)
+    {
+        index.clear();
+        index.reserve(size / 6 + 16);
+
+        bool in_string = false;
+        bool escape = false;
+        size_t i = 0;
+
+        auto scalar = [&](size_t end)
+        {
+            for (; i < end; ++i)
+            {
+                char c = data[i];
+                if (in_string)
+                {
+                    if (escape)
+                        escape = false;
+                    else if (c == '\\')
+                        escape = true;
+                    else if (c == '"')
+                    {
+                        in_string = false;
+                        index.push_back(u32(i));
+                    }
+                }
+                else if (isStructural(c))
+                {
+                    in_string = (c == '"');
+                    index.push_back(u32(i));
+                }
+            }
+        };
+
+#ifdef JSON_SSE2
+        const __m128i q = _mm_set1_epi8('"'), bs = _mm_set1_epi8('\\');
+        const __m128i c1 = _mm_set1_epi8('{'), c2 = _mm_set1_epi8('}'), c3 = _mm_set1_epi8('[');
+        const __m128i c4 = _mm_set1_epi8(']'), c5 = _mm_set1_epi8(':'), c6 = _mm_set1_epi8(',');
+
+        for (; simd && i + 16 <= size;)
+        {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+            u32 quotes = u32(_mm_movemask_epi8(_mm_cmpeq_epi8(v, q)));
+            u32 slashes = u32(_mm_movemask_epi8(_mm_cmpeq_epi8(v, bs)));
+
+            if (slashes || escape)
+            {
+                scalar(i + 16);
+                continue;
+            }
+
+            __m128i s = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, c1), _mm_cmpeq_epi8(v, c2)),
+                                     _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, c3), _mm_cmpeq_epi8(v, c4)),
+                                                  _mm_or_si128(_mm_cmpeq_epi8(v, c5), _mm_cmpeq_epi8(v, c6))));
+            u32 ops = u32(_mm_movemask_epi8(s));
+
+            // bit k of inside = string state after byte k (prefix xor of quotes)
+            u32 inside = quotes;
+            inside ^= inside << 1;
+            inside ^= inside << 2;
+            inside ^= inside << 4;
+            inside ^= inside << 8;
+            inside = (in_string ? ~inside : inside) & 0xffff;
+
+            u32 mask = (ops & ~inside) | quotes;
+            for (; mask; mask &= mask - 1)
+                index.push_back(u32(i + lowestBit(mask)));
+
+            in_string = (inside >> 15) & 1;
+            i += 16;
+        }
+#endif
+        scalar(size);
+        return !in_string;
+    }
+
+    static const char *skipSpace(const char *s, const char *end)
+    {
+        while (s < end && (*s == ' ' || *s == '\t' || *s == '\n' || *s == '\r'))
+            ++s;
+        return s;
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// JsonLoader
+// Two stage reader: structural index (SIMD), then a cursor over the index. Numbers are
+// decoded with from_chars straight into the contiguous json_scene buffers, arrays are
+// sized from the number of commas in the index, so no per value allocations.
+// Materials are created in one material_batch::create call.
+class JsonLoader
+{
+    const char *m_data = nullptr;
+    size_t m_size = 0;
+    std::vector<u32> m_index;
+    size_t m_pos = 0;   // next structural
+    size_t m_last = 0;  // byte after the last consumed structural
+    std::string m_error;
+
+public:
+    const std::string &getError() const { return m_error; }
+
+    bool load(const char *file, json_scene &scene)
+    {
+        std::vector<char> data;
+        m_data = nullptr;
+        std::error_code ec;
+        std::uintmax_t size = std::filesystem::file_size(file, ec); // 64-bit, ftell is 32-bit on windows
+        if (ec)
+            return fail("can't open file");
+        if (size >= 0xffffffffu)
+            return fail("file is too large");
+
+        FILE *f = std::fopen(file, "rb");
+        if (!f)
+            return fail("can't open file");
+
+        data.resize(size_t(size));
+        bool ok = std::fread(data.data(), 1, data.size(), f) == data.size();
+        std::fclose(f);
+        if (!ok)
+            return fail("read error");
+
+        return parse(data.data(), data.size(), scene);
+    }
+
+    bool parse(const char *data, size_t size, json_scene &scene)
+    {
+        scene.clear();
+        m_error.clear();
+        m_data = data;
+        m_size = size;
+        m_pos = 0;
+        m_last = 0;
+
+        if (size >= 0xffffffffu)
+            return fail("file is too large");
+        if (!json_utils::structuralIndex(data, size, m_index))
+            return fail("unterminated string");
+
+        if (!expect('{'))
+            return false;
+        if (!isNext('}'))
+        {
+            do
+            {
+                std::string key;
+                if (!string(key) || !expect(':'))
+                    return false;
+
+                bool ok = (key == "materials") ? materials(scene) : (key == "meshes") ? meshes(scene) : skip();
+                if (!ok)
+                    return false;
+            } while (accept(','));
+        }
+        if (!expect('}'))
+            return false;
+        if (m_pos != m_index.size() || json_utils::skipSpace(m_data + m_last, m_data + m_size) != m_data + m_size)
+            return fail("data after the root object");
+
+        scene.materials.resize(scene.params.size());
+        u32 failed = material_batch::create(scene.params.data(), u32(scene.params.size()), scene.materials.data());
+        for (u32 i = 0; i < scene.materials.size(); ++i)
+            scene.materials[i].setName(scene.names[i].empty() ? "material" : scene.names[i].c_str());
+        if (failed)
+            return fail("invalid material type");
+
+        for (const json_mesh &m : scene.meshes)
+        {
+            if (m.material >= scene.materials.size())
+                return fail("mesh material out of range");
+        }
+        return true;
+    }
+
+private:
+    bool fail(const char *message)
+    {
+        m_error = message;
+        if (m_data)
+            m_error += " at byte " + std::to_string(m_pos < m_index.size() ? m_index[m_pos] : m_size);
+        return false;
+    }
+
+    bool isNext(char c) const { return m_pos < m_index.size() && m_data[m_index[m_pos]] == c; }
+
+    bool accept(char c)
+    {
+        if (!isNext(c))
+            return false;
+        m_last = m_index[m_pos++] + 1;
+        return true;
+    }
+
+    bool expect(char c)
+    {
+        if (accept(c))
+            return true;
+        char message[32];
+        std::snprintf(message, sizeof(message), "expected '%c'", c);
+        return fail(message);
+    }
+
+    bool string(std::string &out)
+    {
+        if (!isNext('"') || m_pos + 1 >= m_index.size())
+            return fail("expected string");
+
+        const char *s = m_data + m_index[m_pos] + 1;
+        const char *e = m_data + m_index[m_pos + 1];
+        out.clear();
+        for (; s < e; ++s)
+        {
+            if (*s == '\\' && s + 1 < e)
+            {
+                ++s;
+                char c = *s;
+                out += (c == 'n') ? '\n' : (c == 't') ? '\t' : (c == 'r') ? '\r' : c; // \uXXXX is kept as is
+            }
+            else
+                out += *s;
+        }
+        m_pos += 2;
+        m_last = size_t(e - m_data) + 1;
+        return true;
+    }
+
+    // scalar text runs from m_last to the next structural
+    bool scalar(const char *&s, const char *&e)
+    {
+        if (m_pos >= m_index.size())
+            return fail("unexpected end");
+        s = json_utils::skipSpace(m_data + m_last, m_data + m_index[m_pos]);
+        e = m_data + m_index[m_pos];
+        while (e > s && (e[-1] == ' ' || e[-1] == '\t' || e[-1] == '\n' || e[-1] == '\r'))
+            --e;
+        return s < e || fail("expected value");
+    }
+
+    bool number(float &v)
+    {
+        const char *s = nullptr, *e = nullptr;
+        if (!scalar(s, e))
+            return false;
+        if (*s == '+')
+            ++s;
+        std::from_chars_result r = std::from_chars(s, e, v);
+        return (r.ec == std::errc() && r.ptr == e) || fail("expected number");
+    }
+
+    bool number(u32 &v)
+    {
+        const char *s = nullptr, *e = nullptr;
+        if (!scalar(s, e))
+            return false;
+        std::from_chars_result r = std::from_chars(s, e, v);
+        return (r.ec == std::errc() && r.ptr == e) || fail("expected integer");
+    }
+
+    bool skip()
+    {
+        if (isNext('"'))
+        {
+            std::string tmp;
+            return string(tmp);
+        }
+        if (isNext('{') || isNext('['))
+        {
+            u32 depth = 0;
+            do
+            {
+                char c = m_data[m_index[m_pos]];
+                depth += (c == '{' || c == '[') ? 1 : 0;
+                depth -= (c == '}' || c == ']') ? 1 : 0;
+                m_last = m_index[m_pos++] + 1;
+            } while (depth && m_pos < m_index.size());
+            return !depth || fail("unbalanced brackets");
+        }
+        const char *s = nullptr, *e = nullptr;
+        return scalar(s, e); // number / true / false / null, the terminator stays
+    }
+
+    // flat numeric array appended to out, size taken from the structural index
+    bool floats(std::vector<float> &out)
+    {
+        if (!expect('['))
+            return false;
+        if (accept(']'))
+            return true;
+
+        size_t count = 1;
+        for (size_t p = m_pos; p < m_index.size() && m_data[m_index[p]] == ','; ++p)
+            ++count;
+
+        // element i lies between structurals m_pos + i - 1 and m_pos + i, large arrays decode in parallel
+        size_t base = out.size();
+        out.resize(base + count);
+        float *dst = out.data() + base;
+        const size_t first = m_pos;
+        std::atomic<size_t> bad{count};
+
+        auto decode = [&](u32 begin, u32 end)
+        {
+            for (u32 i = begin; i < end; ++i)
+            {
+                const char *s = m_data + ((first + i) ? m_index[first + i - 1] + 1 : 0);
+                const char *e = m_data + m_index[first + i];
+                s = json_utils::skipSpace(s, e);
+                while (e > s && (e[-1] == ' ' || e[-1] == '\t' || e[-1] == '\n' || e[-1] == '\r'))
+                    --e;
+                s += (s < e && *s == '+') ? 1 : 0;
+                std::from_chars_result r = std::from_chars(s, e, dst[i]);
+                if (r.ec != std::errc() || r.ptr != e || s == e)
+                {
+                    size_t b = bad;
+                    while (i < b && !bad.compare_exchange_weak(b, i))
+                        ;
+                }
+            }
+        };
+
+        if (count >= 65536)
+            parallel_utils::parallel_for(0, u32(count), 16384, decode);
+        else
+            decode(0, u32(count));
+
+        m_pos = first + std::min(count, size_t(bad));
+        if (bad != count)
+            return fail("expected number");
+        m_last = m_index[m_pos - 1] + 1;
+        return m_data[m_last - 1] == ']' || fail("expected ']'");
+    }
+
+    bool materials(json_scene &scene)
+    {
+        if (!expect('['))
+            return false;
+        if (accept(']'))
+            return true;
+
+        do
+        {
+            material_params p = material_params();
+            p.refractive = 1.0f;
+            std::string name;
+
+            if (!expect('{'))
+                return false;
+            if (!isNext('}'))
+            {
+                do
+                {
+                    std::string key;
+                    if (!string(key) || !expect(':'))
+                        return false;
+
+                    bool ok;
+                    if (key == "name")
+                        ok = string(name);
+                    else if (key == "type")
+                        ok = type(p.type);
+                    else if (key == "color")
+                    {
+                        std::vector<float> c;
+                        ok = floats(c) && (c.size() == 3 || fail("color needs 3 values"));
+                        if (ok)
+                            std::memcpy(p.color, c.data(), sizeof(p.color));
+                    }
+                    else if (key == "reflection_factor")
+                        ok = number(p.reflection_factor);
+                    else if (key == "reflection_coating")
+                        ok = number(p.reflection_coating);
+                    else if (key == "transparency")
+                        ok = number(p.transparency);
+                    else if (key == "refractive")
+                        ok = number(p.refractive);
+                    else if (key == "shininess")
+                        ok = number(p.shininess);
+                    else
+                        ok = skip();
+                    if (!ok)
+                        return false;
+                } while (accept(','));
+            }
+            if (!expect('}'))
+                return false;
+
+            if (name.size() >= max_material_name)
+                name.resize(max_material_name - 1);
+            scene.params.push_back(p);
+            scene.names.push_back(name);
+        } while (accept(','));
+        return expect(']');
+    }
+
+    bool type(u32 &t)
+    {
+        if (!isNext('"'))
+            return number(t);
+
+        std::string name;
+        if (!string(name))
+            return false;
+        t = (name == "transparent") ? material_type::transparent : (name == "metallic") ? material_type::metallic : (name == "painted") ? material_type::painted : material_type::undefined;
+        return t != material_type::undefined || fail("unknown material type");
+    }
+
+    bool meshes(json_scene &scene)
+    {
+        if (!expect('['))
+            return false;
+        if (accept(']'))
+            return true;
+
+        do
+        {
+            json_mesh m;
+            m.offset = scene.vl.size() / 3;
+            size_t vd_size = scene.vd.size();
+
+            if (!expect('{'))
+                return false;
+            if (!isNext('}'))
+            {
+                do
+                {
+                    std::string key;
+                    if (!string(key) || !expect(':'))
+                        return false;
+
+                    bool ok = (key == "material") ? number(m.material) : (key == "vl") ? floats(scene.vl) : (key == "vd") ? floats(scene.vd) : skip();
+                    if (!ok)
+                        return false;
+                } while (accept(','));
+            }
+            if (!expect('}'))
+                return false;
+
+            size_t values = scene.vl.size() - m.offset * 3;
+            if (values % 3)
+                return fail("vl size is not a multiple of 3");
+            if (scene.vd.size() == vd_size)
+                scene.vd.resize(scene.vl.size(), 0.0f);
+            if (scene.vd.size() != scene.vl.size())
+                return fail("vd size differs from vl");
+
+            m.count = u32(values / 3);
+            scene.meshes.push_back(m);
+        } while (accept(','));
+        return expect(']');
+    }
+};
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <memory_resource>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// LightGroups
+// Illuminance of calc points per light group, dense [group][channel][point].
+// Switching a light scene (dimming, emergency, presets) is a re-weighting
+//   vs = sum(w_k * E_k)
+// followed by the coloring pass, no solver run.
+class LightGroups
+{
+    u32 m_groups = 0;
+    u32 m_points = 0;
+    std::pmr::vector<float> m_E;
+
+public:
+    static const u32 block_size = 512; // points per block (recombined block stays in L1)
+
+    explicit LightGroups(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : m_E(resource)
+    {
+    }
+
+    void create(u32 groups, u32 points)
+    {
+        m_groups = groups;
+        m_points = points;
+        m_E.assign(size_t(groups) * 3 * points, 0.0f);
+    }
+
+    u32 getGroupsCount() const { return m_groups; }
+    u32 getPointsCount() const { return m_points; }
+
+    // channel - 0 (r), 1 (g), 2 (b)
+    float *getPlane(u32 group, u32 channel) { return m_E.data() + (size_t(group) * 3 + channel) * m_points; }
+    const float *getPlane(u32 group, u32 channel) const { return m_E.data() + (size_t(group) * 3 + channel) * m_points; }
+
+    void setIlluminance(u32 group, u32 point, const color3f &E)
+    {
+        assert(group < m_groups && point < m_points);
+        getPlane(group, 0)[point] = E.r;
+        getPlane(group, 1)[point] = E.g;
+        getPlane(group, 2)[point] = E.b;
+    }
+
+    // vs = sum(w_k * E_k) for points [begin, end), weights - getGroupsCount() dimming factors
+    void recombine(const float *weights, u32 begin, u32 end, float *vs_r, float *vs_g, float *vs_b) const
+    {
+        assert(begin <= end && end <= m_points);
+        float *out[3] = {vs_r, vs_g, vs_b};
+        u32 count = end - begin;
+
+        for (u32 ch = 0; ch < 3; ++ch)
+        {
+            float *__restrict o = out[ch];
+            for (u32 i = 0; i < count; ++i)
+                o[i] = 0.0f;
+
+            for (u32 k = 0; k < m_groups; ++k)
+            {
+                float w = weights[k];
+                if (w == 0.0f)
+                    continue;
+
+                const float *__restrict e = getPlane(k, ch) + begin;
+                for (u32 i = 0; i < count; ++i)
+                    o[i] += w * e[i];
+            }
+        }
+    }
+
+    // recombine and color straight into planes of plane_size floats (e.g. GridSurface::getPlane(plane_c_r ...)),
+    // false if weights_count is not the number of groups or plane_size is not the number of points
+    bool normalizeColor(const float *weights, u32 weights_count, const color3f &cd, float *c_r, float *c_g, float *c_b, float *cg, u32 plane_size) const
+    {
+        if (weights_count != m_groups || plane_size != m_points || !m_points || !weights || !c_r || !c_g || !c_b || !cg)
+            return false;
+
+        parallel_utils::parallel_for(0, m_points, block_size, [&](u32 begin, u32 end)
+        {
+            float vs[3][block_size];
+            recombine(weights, begin, end, vs[0], vs[1], vs[2]);
+
+            color4f c, g;
+            for (u32 i = begin; i < end; ++i)
+            {
+                u32 k = i - begin;
+                PuryaMesh::colorPoint(color3f(vs[0][k], vs[1][k], vs[2][k]), cd, c, g);
+                c_r[i] = c.r;
+                c_g[i] = c.g;
+                c_b[i] = c.b;
+                cg[i] = g.r;
+            }
+        });
+        return true;
+    }
+
+    // recombine and color the color planes of a grid with the points of the groups
+    bool normalizeColor(const float *weights, u32 weights_count, GridSurface &grid) const
+    {
+        return normalizeColor(weights, weights_count, grid.getMaterial().getDiffuseSpectrumColor(), grid.getPlane(grid_plane::plane_c_r), grid.getPlane(grid_plane::plane_c_g),
+                              grid.getPlane(grid_plane::plane_c_b), grid.getPlane(grid_plane::plane_cg), grid.getPointsCount());
+    }
+
+    // recombine and color the points of mesh (vs, c, cg are written, vl / vd are kept)
+    bool normalizeColor(const float *weights, u32 weights_count, Geometry &mesh) const
+    {
+        if (weights_count != m_groups || mesh.getPointsCount() != m_points || !m_points || !weights)
+            return false;
+
+        color3f cd = mesh.getMaterial().getDiffuseSpectrumColor();
+
+        parallel_utils::parallel_for(0, m_points, block_size, [&](u32 begin, u32 end)
+        {
+            float vs[3][block_size];
+            recombine(weights, begin, end, vs[0], vs[1], vs[2]);
+
+            for (u32 i = begin; i < end; ++i)
+            {
+                u32 k = i - begin;
+                vertex *v = mesh[i];
+                v->vs.set(vs[0][k], vs[1][k], vs[2][k]);
+                PuryaMesh::colorPoint(v->vs, cd, v->c, v->cg);
+            }
+        });
+        return true;
+    }
+};
@@ -68,6 +68,10 @@ private:
     float m_N = 1.0f;
     float m_opacity = 1.0f;
 
+    // spectral (SPECTRAL_BANDS, linear)
+    spectrumf m_spectral_reflectance;  ///< diffuse + specular reflectance
+    spectrumf m_spectral_transmission; ///< transmission
+
 #ifdef _HIDE
     // textures params (common)
     texture_params m_texture_prms;
@@ -180,6 +184,10 @@ public:
         m_reflection_coating = other.m_reflection_coating;
         m_transparency = other.m_transparency;
         m_refractive = other.m_refractive;
+
+        m_coeff = other.m_coeff;
+        m_Y = other.m_Y;
+        m_coeff_T = other.m_coeff_T;
     }
 
     void copyEnergetic(const Material& other)
@@ -187,6 +195,9 @@ public:
         m_diffuse_spectrum = other.m_diffuse_spectrum;
         m_specular_spectrum = other.m_specular_spectrum;
         m_transmission_spectrum = other.m_transmission_spectrum;
+
+        m_spectral_reflectance = other.m_spectral_reflectance;
+        m_spectral_transmission = other.m_spectral_transmission;
     }
 
     void copyGraphics(const Material& other)
@@ -197,6 +208,8 @@ public:
         m_specular = other.m_specular;
         m_emission = other.m_emission;
         m_shininess = other.m_shininess;
+        m_opacity = other.m_opacity;
+        m_N = other.m_N;
 
 #ifdef _HIDE
         m_texture_prms = other.m_texture_prms;
@@ -297,6 +310,12 @@ public:
         m_transmission_spectrum = transmission;
     }
 
+    // measured spectra replace the ones derived from RGB until the next recalc
+    void setSpectralReflectance(const spectrumf& reflectance) { m_spectral_reflectance = reflectance; }
+    const spectrumf& getSpectralReflectance() const { return m_spectral_reflectance; }
+    void setSpectralTransmission(const spectrumf& transmission) { m_spectral_transmission = transmission; }
+    const spectrumf& getSpectralTransmission() const { return m_spectral_transmission; }
+
     bool isValidSpectrums() const
     {
         return (((m_diffuse_spectrum.r + m_specular_spectrum.r + m_transmission_spectrum.r) <= 1.0f) && ((m_diffuse_spectrum.g + m_specular_spectrum.g + m_transmission_spectrum.g) <= 1.0f) && ((m_diffuse_spectrum.b + m_specular_spectrum.b + m_transmission_spectrum.b) <= 1.0f)) ? true : false;
@@ -326,6 +345,12 @@ public:
     void setShininess(float shininess) { m_shininess = shininess; }
     const float& getShininess() const { return m_shininess; }
 
+    // graphics (opengl data)
+    void setOpacity(float opacity) { m_opacity = opacity; }
+    const float& getOpacity() const { return m_opacity; }
+    void setN(float N) { m_N = N; }
+    const float& getN() const { return m_N; }
+
     void setMaterialParams(float reflection_factor, float reflection_coating, float transparency, float refractive)
     {
         m_reflection_factor = reflection_factor;
@@ -444,10 +469,7 @@ public:
             return false;
         }
 
-        material_utils::clamp_color(const_cast<color3f&>(color));   // Öâåò â ôîðìàòå sRGB [0..1] [0..1] [0..1]
-        material_utils::clamp_value(reflection_factor, 0.0f, 0.9f);  // Êîýôôèöèåíò îòðàæåíèÿ (Reflection factor) [0..0.9]
-        material_utils::clamp_value(reflection_coating, 0.0f, 1.0f); // Îòðàæåíèå (Reflection coating) [0..1]
-        material_utils::clamp_value(transparency, 0.0f, 1.0f);       // Êîýôôèöèåíò ïåðåäà÷è (degree of transmission) [0..1]
+        clampParams(const_cast<color3f&>(color), reflection_factor, reflection_coating, transparency);
         material_utils::clamp_value(refractive, 1.0f, 2.0f);         // Ïîêàçàòåëü ïðåëîìëåíèÿ (Refractive index) [1..2]
         material_utils::clamp_value(shininess, 0.0f, 1.0f);          // Áëåñêîñòü (Shininess) [0..1]
 
@@ -584,27 +606,25 @@ public:
         return true;
     }
 
-private:
-    // Render --------------------------------------------------------
-    bool recalcMaterial()
+    // create() input ranges
+    static void clampParams(color3f& color, float& reflection_factor, float& reflection_coating, float& transparency)
     {
-        color3f diff;
-        color3f spec;
-        color3f amb;
-        color3f trans;
-
-        color3f color = getColor();
+        material_utils::clamp_color(color);                          // sRGB [0..1] [0..1] [0..1]
+        material_utils::clamp_value(reflection_factor, 0.0f, 0.9f);  // Reflection factor [0..0.9]
+        material_utils::clamp_value(reflection_coating, 0.0f, 1.0f); // Reflection coating [0..1]
+        material_utils::clamp_value(transparency, 0.0f, 1.0f);       // degree of transmission [0..1]
+    }
 
-        float ReflF = getReflectionFactor();
-        float ReflC = getReflectionCoating();
-        float Trans = getTransparency();
-        float N = getRefractive();
-        float Shin = 0.0f;
-        float opacity = 0.0f;
+    // linear spectra of a type from its params (recalcMaterial, material_fit), ambient - linear ambient color
+    static void calcSpectrums(u32 type, const color3f& color, float ReflF, float ReflC, float Trans, color3f& diffuse, color3f& specular, color3f& transmission, color3f& ambient)
+    {
+        diffuse.set(0.0f, 0.0f, 0.0f);
+        specular.set(0.0f, 0.0f, 0.0f);
+        transmission.set(0.0f, 0.0f, 0.0f);
+        ambient.set(0.0f, 0.0f, 0.0f);
 
-        if (isTypeMetallic())
+        if (type == material_type::metallic)
         {
-
             float Ys = ReflF * ReflC;
             float Yd = ReflF * (1.0f - ReflC);
 
@@ -613,20 +633,13 @@ private:
             if (Ysum > 0)
             {
                 color3f Yrgb = material_utils::changeY(color, Ysum);
-                diff = Yrgb * (Yd / Ysum);
-                spec = Yrgb * (Ys / Ysum);
-                amb = spec;
+                diffuse = Yrgb * (Yd / Ysum);
+                specular = Yrgb * (Ys / Ysum);
+                ambient = specular;
             }
-
-            trans.set(0.0f, 0.0f, 0.0f);
-
-            opacity = 0.0f;
-            Shin = 0.0f;
-            N = 1.0f;
         }
-        else if (isTypePainted())
+        else if (type == material_type::painted)
         {
-
             float Ys = ReflF * ReflC;
             float Yd = ReflF * (1 - ReflC); // Ys
 
@@ -635,13 +648,50 @@ private:
             if (Ysum > 0)
             {
                 color3f Yrgb = material_utils::changeY(color, Ysum);
-                diff = Yrgb * (Yd / Ysum);
-                spec.set(Ys, Ys, Ys); // grayscale
-                amb = spec;
+                diffuse = Yrgb * (Yd / Ysum);
+                specular.set(Ys, Ys, Ys); // grayscale
+                ambient = specular;
+            }
+        }
+        else if (type == material_type::transparent)
+        {
+            float Ysum = ReflF + Trans;
+
+            if (Ysum > 0)
+            {
+                color3f Yrgb = material_utils::changeY(color, Ysum);
+                specular = Yrgb * (ReflF / Ysum);
+                transmission = Yrgb * (Trans / Ysum);
+                ambient = Yrgb;
             }
+        }
+    }
+
+private:
+    // Render --------------------------------------------------------
+    bool recalcMaterial()
+    {
+        color3f diff;
+        color3f spec;
+        color3f amb;
+        color3f trans;
+
+        float ReflF = getReflectionFactor();
+        float Trans = getTransparency();
+        float N = getRefractive();
+        float Shin = 0.0f;
+        float opacity = 0.0f;
 
-            trans.set(0.0f, 0.0f, 0.0f);
+        calcSpectrums(getType(), getColor(), ReflF, getReflectionCoating(), Trans, diff, spec, trans, amb);
 
+        if (isTypeMetallic())
+        {
+            opacity = 0.0f;
+            Shin = 0.0f;
+            N = 1.0f;
+        }
+        else if (isTypePainted())
+        {
             opacity = 0.0f;
             Shin = 0.6f; // 80/128
             N = 1.0f;
@@ -649,17 +699,8 @@ private:
         else if (isTypeTransparent())
         {
             float Ysum = ReflF + Trans;
-
-            color3f Yrgb = material_utils::changeY(color, Ysum);
-
-            diff.set(0, 0, 0);
             if (Ysum > 0)
-            {
-                spec = Yrgb * (ReflF / Ysum);
-                trans = Yrgb * (Trans / Ysum);
                 opacity = Trans / Ysum;
-                amb = Yrgb;
-            }
 
             Shin = 0.3f; // 40/128
             N = N;
@@ -675,6 +716,9 @@ private:
         m_specular_spectrum = specular;
         m_transmission_spectrum = transmission;
 
+        spectral_utils::from_rgb(color3f(diffuse) + specular, m_spectral_reflectance);
+        spectral_utils::from_rgb(transmission, m_spectral_transmission);
+
         // graphics (opengl data)
         m_diffuse = material_utils::from_linear(diffuse);
         m_specular = material_utils::from_linear(specular);
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <vector>
+
+// Intermediate states between two materials (previews, animated type / color changes).
+// A state at t is the convex combination (1 - t) * a + t * b of the linear spectra, so energy is
+// conserved: the diffuse + specular + transmission sum of every channel stays <= 1 when it does
+// for both ends and every state passes isValidSpectrums. Parameters follow the spectra (the
+// reflection factor and the specular share are linear in them), the type switches at t = 0.5.
+namespace material_blend
+{
+    // per-material values the lerp needs, computed once per batch
+    struct blend_end
+    {
+        const Material *mtl;
+        color3f color;   ///< user color, linear
+        color3f ambient; ///< linear
+        float reflection_factor;
+        float specular;     ///< reflection_factor * reflection_coating
+        float transmission; ///< transparency of transparent materials, 0 otherwise
+
+        explicit blend_end(const Material &m)
+            : mtl(&m),
+              color(material_utils::to_linear(m.getColor())),
+              ambient(material_utils::to_linear(m.getAmbientColor())),
+              reflection_factor(m.getReflectionFactor()),
+              specular(m.isTypeTransparent() ? 0.0f : m.getReflectionFactor() * m.getReflectionCoating()),
+              transmission(m.isTypeTransparent() ? m.getTransparency() : 0.0f)
+        {
+        }
+    };
+
+    static float lerp(float a, float b, float t) { return a + (b - a) * t; }
+
+    static color3f lerp(const color3f &a, const color3f &b, float t) { return color3f(a) + (color3f(b) - a) * t; }
+
+    // rounding of the lerp may push a channel sum equal to 1 just above it
+    static void clampSpectrums(color3f &d, color3f &s, color3f &tr)
+    {
+        float *ch[3][3] = {{&d.r, &s.r, &tr.r}, {&d.g, &s.g, &tr.g}, {&d.b, &s.b, &tr.b}};
+        for (auto &c : ch)
+        {
+            float sum = *c[0] + *c[1] + *c[2];
+            if (sum > 1.0f)
+            {
+                for (float *v : c)
+                    *v /= sum;
+            }
+        }
+    }
+
+    static void blend(const blend_end &a, const blend_end &b, float t, Material &out)
+    {
+        material_utils::clamp_value(t, 0.0f, 1.0f);
+        const Material &ma = *a.mtl;
+        const Material &mb = *b.mtl;
+        const Material &nearest = t < 0.5f ? ma : mb;
+
+        out = nearest;
+
+        // params
+        float reflection_factor = lerp(a.reflection_factor, b.reflection_factor, t);
+        float specular = lerp(a.specular, b.specular, t);
+        float transparency = nearest.isTypeTransparent() ? lerp(a.transmission, b.transmission, t) : nearest.getTransparency();
+        float coating = nearest.isTypeTransparent() ? nearest.getReflectionCoating() : (reflection_factor > 0.0f ? specular / reflection_factor : 0.0f);
+        out.setColor(material_utils::from_linear(lerp(a.color, b.color, t)));
+        out.setMaterialParams(reflection_factor, coating, transparency, lerp(ma.getRefractive(), mb.getRefractive(), t));
+        out.setGlobalY(lerp(ma.getGlobalY(), mb.getGlobalY(), t));
+        out.setCoefficientTransition(lerp(ma.getCoefficientTransition(), mb.getCoefficientTransition(), t));
+        out.setCoefficientT(lerp(ma.getCoefficientT(), mb.getCoefficientT(), t));
+
+        // energetic (linear)
+        color3f d = lerp(ma.getDiffuseSpectrum(), mb.getDiffuseSpectrum(), t);
+        color3f s = lerp(ma.getSpecularSpectrum(), mb.getSpecularSpectrum(), t);
+        color3f tr = lerp(ma.getTransmissionSpectrum(), mb.getTransmissionSpectrum(), t);
+        clampSpectrums(d, s, tr);
+        out.setSpectrums(d, s, tr);
+
+        out.setSpectralReflectance(ma.getSpectralReflectance() * (1.0f - t) + mb.getSpectralReflectance() * t);
+        out.setSpectralTransmission(ma.getSpectralTransmission() * (1.0f - t) + mb.getSpectralTransmission() * t);
+
+        // graphics (opengl data), derived from the blended spectra as Material::convertColors does
+        // (setColors would mark the material as undefined)
+        out.setAmbientColor(material_utils::from_linear(lerp(a.ambient, b.ambient, t)));
+        out.setDiffuseColor(material_utils::from_linear(d));
+        out.setSpecularColor(material_utils::from_linear(s));
+        out.setEmissionColor(lerp(ma.getEmissionColor(), mb.getEmissionColor(), t));
+        out.setOpacity(lerp(ma.getOpacity(), mb.getOpacity(), t));
+        out.setN(lerp(ma.getN(), mb.getN(), t));
+        out.setShininess(lerp(ma.getShininess(), mb.getShininess(), t));
+    }
+
+    // single state, t in [0, 1]
+    static void blend(const Material &a, const Material &b, float t, Material &out)
+    {
+        blend(blend_end(a), blend_end(b), t, out);
+    }
+
+    // out[i] = state at t[i], false if an end is not valid (out is not touched)
+    static bool blend(const Material &a, const Material &b, const float *t, u32 count, Material *out)
+    {
+        if (!a.isValidSpectrums() || !b.isValidSpectrums())
+            return false;
+
+        blend_end ea(a), eb(b);
+        parallel_utils::parallel_for(0, count, 256, [&](u32 begin, u32 end)
+        {
+            for (u32 i = begin; i < end; ++i)
+                blend(ea, eb, t[i], out[i]);
+        });
+        return true;
+    }
+
+    // count evenly spaced states, out[0] = a, out[count - 1] = b (comparison strip, animation frames)
+    static bool strip(const Material &a, const Material &b, u32 count, Material *out)
+    {
+        std::vector<float> t(count);
+        for (u32 i = 0; i < count; ++i)
+            t[i] = count > 1 ? float(i) / float(count - 1) : 0.0f;
+        return blend(a, b, t.data(), count, out);
+    }
+
+    // states from mtl to mtl.updateType(type)
+    static bool typeTransition(const Material &mtl, u32 type, u32 count, Material *out)
+    {
+        Material target = mtl;
+        target.updateType(type);
+        return strip(mtl, target, count, out);
+    }
+}
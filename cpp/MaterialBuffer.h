@@ -0,0 +1,146 @@
+#pragma once
+
+#include <vector>
+
+// one material in the buffer, vec3 + float rows: identical in std140 and std430
+// shininess is the Phong exponent [1..128] (Material::getShininess is [0..1], see ViewLuminance)
+//   struct Material { vec3 diffuse; float shininess; vec3 ambient; float opacity; vec3 specular; float N; };
+//   layout(std140) uniform Materials { Material materials[COUNT]; };
+struct material_std140
+{
+    float diffuse[3];
+    float shininess; ///< Phong exponent
+    float ambient[3];
+    float opacity;
+    float specular[3];
+    float N;
+};
+
+static_assert(sizeof(material_std140) == 48, "std140 array stride must be a multiple of 16");
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// MaterialBuffer
+// Material table packed for a single uniform / storage buffer (DialuxShader uniforms per material).
+// Indices are stable: removed slots are zeroed and reused by later adds. sync() repacks materials
+// whose handle version changed, the viewer uploads only getDirtyRanges() and calls clearDirty().
+class MaterialBuffer
+{
+    std::vector<material_std140> m_data;
+    std::vector<MaterialHandle> m_materials;
+    std::vector<u32> m_versions;
+    std::vector<u32> m_free;
+    std::vector<std::pair<u32, u32>> m_dirty; // [begin, end) in elements, sorted, disjoint
+
+public:
+    // dirty ranges closer than this are merged into one upload
+    u32 merge_gap = 4;
+
+    static void pack(const Material &mtl, material_std140 &out)
+    {
+        const color3f &d = mtl.getDiffuseColor();
+        const color3f &a = mtl.getAmbientColor();
+        const color3f &s = mtl.getSpecularColor();
+        out.diffuse[0] = d.r;
+        out.diffuse[1] = d.g;
+        out.diffuse[2] = d.b;
+        out.ambient[0] = a.r;
+        out.ambient[1] = a.g;
+        out.ambient[2] = a.b;
+        out.specular[0] = s.r;
+        out.specular[1] = s.g;
+        out.specular[2] = s.b;
+        out.shininess = material_utils::to_phong_exponent(mtl.getShininess());
+        out.opacity = mtl.getOpacity();
+        out.N = mtl.getN();
+    }
+
+    u32 add(const MaterialHandle &mtl)
+    {
+        u32 index;
+        if (!m_free.empty())
+        {
+            index = m_free.back();
+            m_free.pop_back();
+        }
+        else
+        {
+            index = getCount();
+            m_data.emplace_back();
+            m_materials.emplace_back();
+            m_versions.push_back(0);
+        }
+
+        m_materials[index] = mtl;
+        m_versions[index] = mtl.getVersion();
+        pack(mtl.get(), m_data[index]);
+        markDirty(index, index + 1);
+        return index;
+    }
+
+    void remove(u32 index)
+    {
+        assert(index < getCount() && m_materials[index].isValid());
+        m_materials[index] = MaterialHandle();
+        m_data[index] = material_std140();
+        m_free.push_back(index);
+        markDirty(index, index + 1);
+    }
+
+    // repack one slot (material replaced by another handle)
+    void update(u32 index, const MaterialHandle &mtl)
+    {
+        assert(index < getCount());
+        m_materials[index] = mtl;
+        m_versions[index] = mtl.getVersion();
+        pack(mtl.get(), m_data[index]);
+        markDirty(index, index + 1);
+    }
+
+    // repack edited materials, returns the number repacked
+    u32 sync()
+    {
+        u32 changed = 0;
+        for (u32 i = 0; i < getCount(); ++i)
+        {
+            const MaterialHandle &mtl = m_materials[i];
+            if (!mtl.isValid() || mtl.getVersion() == m_versions[i])
+                continue;
+
+            m_versions[i] = mtl.getVersion();
+            pack(mtl.get(), m_data[i]);
+            markDirty(i, i + 1);
+            ++changed;
+        }
+        return changed;
+    }
+
+    u32 getCount() const { return u32(m_data.size()); }
+    const void *data() const { return m_data.data(); }
+    size_t getSize() const { return m_data.size() * sizeof(material_std140); }
+    const material_std140 &operator[](u32 index) const { return m_data[index]; }
+
+    // element ranges [begin, end) to upload, byte offset = begin * sizeof(material_std140)
+    const std::vector<std::pair<u32, u32>> &getDirtyRanges() const { return m_dirty; }
+    bool isDirty() const { return !m_dirty.empty(); }
+    void clearDirty() { m_dirty.clear(); }
+
+private:
+    void markDirty(u32 begin, u32 end)
+    {
+        // first range that ends at or after begin - gap
+        auto it = std::lower_bound(m_dirty.begin(), m_dirty.end(), begin, [this](const std::pair<u32, u32> &r, u32 b)
+                                   { return r.second + merge_gap < b; });
+
+        // merge every range that starts before end + gap
+        auto last = it;
+        while (last != m_dirty.end() && last->first <= end + merge_gap)
+        {
+            begin = std::min(begin, last->first);
+            end = std::max(end, last->second);
+            ++last;
+        }
+
+        it = m_dirty.erase(it, last);
+        m_dirty.insert(it, std::make_pair(begin, end));
+    }
+};
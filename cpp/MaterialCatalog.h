@@ -0,0 +1,260 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+struct catalog_query
+{
+    u32 type = material_type::undefined; ///< undefined - any type
+    color3f color;                       ///< sRGB
+    float reflection_factor = 0.0f;
+};
+
+struct catalog_match
+{
+    u32 index = ~0u;        ///< catalog index, ~0u - no match
+    float distance = 0.0f;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// MaterialCatalog
+// Nearest catalog material for an arbitrary color / reflection factor. Key space is
+// (L, a, b, ReflF * refl_weight), one k-d tree per material type (type is a hard constraint).
+// Distance is delta E 1976 extended by the reflection factor term.
+class MaterialCatalog
+{
+    static const u32 dims = 4;
+    static const u32 leaf_size = 8;
+
+    struct entry
+    {
+        float key[dims];
+        u32 index;
+    };
+
+    struct node
+    {
+        u32 begin, end; // entries
+        u32 left, right; // children, 0 - leaf
+        u32 axis;
+        float split;
+    };
+
+    struct tree
+    {
+        std::vector<entry> entries;
+        std::vector<node> nodes;
+    };
+
+    std::vector<MaterialHandle> m_materials;
+    tree m_trees[material_type::painted + 1];
+    float m_refl_weight;
+
+public:
+    // refl_weight - delta E per unit of reflection factor
+    explicit MaterialCatalog(float refl_weight = 100.0f) : m_refl_weight(refl_weight) {}
+
+    u32 add(const MaterialHandle &mtl)
+    {
+        m_materials.push_back(mtl);
+        return u32(m_materials.size() - 1);
+    }
+
+    u32 getCount() const { return u32(m_materials.size()); }
+    const MaterialHandle &get(u32 index) const { return m_materials[index]; }
+
+    void key(const color3f &color, float reflection_factor, float *k) const
+    {
+        color3f lab = mesh_utils::to_lab(color);
+        k[0] = lab.r;
+        k[1] = lab.g;
+        k[2] = lab.b;
+        k[3] = reflection_factor * m_refl_weight;
+    }
+
+    // catalog snapshot: materials edited later keep their old keys until the next build
+    void build()
+    {
+        for (tree &t : m_trees)
+        {
+            t.entries.clear();
+            t.nodes.clear();
+        }
+
+        for (u32 i = 0; i < getCount(); ++i)
+        {
+            const Material &mtl = m_materials[i].get();
+            if (mtl.getType() > material_type::painted)
+                continue;
+
+            entry e;
+            key(mtl.getColor(), mtl.getReflectionFactor(), e.key);
+            e.index = i;
+            m_trees[mtl.getType()].entries.push_back(e);
+        }
+
+        for (tree &t : m_trees)
+        {
+            if (!t.entries.empty())
+                split(t, 0, u32(t.entries.size()));
+        }
+    }
+
+    // k nearest, sorted by distance, returns the number found
+    u32 nearest(const catalog_query &q, catalog_match *out, u32 k) const
+    {
+        float qk[dims];
+        key(q.color, q.reflection_factor, qk);
+
+        u32 found = 0;
+        for (u32 type = 0; type <= material_type::painted; ++type)
+        {
+            if (q.type == material_type::undefined || q.type == type)
+                found = search(m_trees[type], 0, qk, out, found, k);
+        }
+
+        for (u32 i = 0; i < found; ++i)
+            out[i].distance = std::sqrt(out[i].distance);
+        return found;
+    }
+
+    // all materials within radius, sorted by distance
+    u32 range(const catalog_query &q, float radius, std::vector<catalog_match> &out) const
+    {
+        float qk[dims];
+        key(q.color, q.reflection_factor, qk);
+
+        out.clear();
+        for (u32 type = 0; type <= material_type::painted; ++type)
+        {
+            if (q.type == material_type::undefined || q.type == type)
+                collect(m_trees[type], 0, qk, radius * radius, out);
+        }
+
+        for (catalog_match &m : out)
+            m.distance = std::sqrt(m.distance);
+        std::sort(out.begin(), out.end(), [](const catalog_match &a, const catalog_match &b) { return a.distance < b.distance; });
+        return u32(out.size());
+    }
+
+    // out - [query][k], unused slots have index ~0u
+    void nearest(const catalog_query *q, u32 count, catalog_match *out, u32 k) const
+    {
+        parallel_utils::parallel_for(0, count, 256, [&](u32 begin, u32 end)
+        {
+            for (u32 i = begin; i < end; ++i)
+            {
+                catalog_match *m = out + size_t(i) * k;
+                u32 found = nearest(q[i], m, k);
+                for (u32 j = found; j < k; ++j)
+                    m[j] = catalog_match();
+            }
+        });
+    }
+
+private:
+    u32 split(tree &t, u32 begin, u32 end)
+    {
+        u32 id = u32(t.nodes.size());
+        t.nodes.push_back({begin, end, 0, 0, 0, 0.0f});
+        if (end - begin <= leaf_size)
+            return id;
+
+        // widest axis
+        float lo[dims], hi[dims];
+        for (u32 a = 0; a < dims; ++a)
+            lo[a] = hi[a] = t.entries[begin].key[a];
+        for (u32 i = begin + 1; i < end; ++i)
+        {
+            for (u32 a = 0; a < dims; ++a)
+            {
+                lo[a] = std::min(lo[a], t.entries[i].key[a]);
+                hi[a] = std::max(hi[a], t.entries[i].key[a]);
+            }
+        }
+        u32 axis = 0;
+        for (u32 a = 1; a < dims; ++a)
+            axis = (hi[a] - lo[a] > hi[axis] - lo[axis]) ? a : axis;
+
+        u32 mid = (begin + end) / 2;
+        std::nth_element(t.entries.begin() + begin, t.entries.begin() + mid, t.entries.begin() + end,
+                         [axis](const entry &a, const entry &b) { return a.key[axis] < b.key[axis]; });
+
+        float value = t.entries[mid].key[axis]; // children reorder their ranges
+        u32 left = split(t, begin, mid);
+        u32 right = split(t, mid, end);
+
+        node &n = t.nodes[id];
+        n.left = left;
+        n.right = right;
+        n.axis = axis;
+        n.split = value;
+        return id;
+    }
+
+    static float distance2(const float *a, const float *b)
+    {
+        float d = 0.0f;
+        for (u32 i = 0; i < dims; ++i)
+            d += (a[i] - b[i]) * (a[i] - b[i]);
+        return d;
+    }
+
+    // out[0..found) sorted by squared distance
+    static u32 search(const tree &t, u32 id, const float *q, catalog_match *out, u32 found, u32 k)
+    {
+        if (t.nodes.empty() || !k)
+            return found;
+
+        const node &n = t.nodes[id];
+        if (!n.left)
+        {
+            for (u32 i = n.begin; i < n.end; ++i)
+            {
+                float d = distance2(q, t.entries[i].key);
+                if (found == k && d >= out[k - 1].distance)
+                    continue;
+
+                u32 j = (found < k) ? found++ : k - 1;
+                for (; j > 0 && out[j - 1].distance > d; --j)
+                    out[j] = out[j - 1];
+                out[j].index = t.entries[i].index;
+                out[j].distance = d;
+            }
+            return found;
+        }
+
+        float diff = q[n.axis] - n.split;
+        u32 first = (diff < 0.0f) ? n.left : n.right;
+        u32 second = (diff < 0.0f) ? n.right : n.left;
+
+        found = search(t, first, q, out, found, k);
+        if (found < k || diff * diff < out[k - 1].distance)
+            found = search(t, second, q, out, found, k);
+        return found;
+    }
+
+    static void collect(const tree &t, u32 id, const float *q, float radius2, std::vector<catalog_match> &out)
+    {
+        if (t.nodes.empty())
+            return;
+
+        const node &n = t.nodes[id];
+        if (!n.left)
+        {
+            for (u32 i = n.begin; i < n.end; ++i)
+            {
+                float d = distance2(q, t.entries[i].key);
+                if (d <= radius2)
+                    out.push_back({t.entries[i].index, d});
+            }
+            return;
+        }
+
+        float diff = q[n.axis] - n.split;
+        if (diff < 0.0f || diff * diff <= radius2)
+            collect(t, n.left, q, radius2, out);
+        if (diff >= 0.0f || diff * diff <= radius2)
+            collect(t, n.right, q, radius2, out);
+    }
+};
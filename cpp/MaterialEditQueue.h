@@ -0,0 +1,245 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// material property changed by one UI edit (Material::update* method)
+enum edit_field
+{
+    edit_type = 0,
+    edit_color,
+    edit_reflection_factor,
+    edit_reflection_coating,
+    edit_transparency,
+    edit_refractive,
+    edit_fields_count
+};
+
+struct material_edit
+{
+    u32 material; ///< MaterialStore id
+    u32 field;    ///< edit_field
+    float value[3]; ///< color: sRGB, other fields: value[0]
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// MaterialEditQueue
+// Carries material edits from the UI thread(s) to one compute thread that publishes them to a MaterialStore.
+// push() is lock-free. The compute thread takes all pending edits at once, collapses every run of edits of the
+// same field of a material to its latest value (type edits are kept) and applies the rest to one copy per
+// material in push order, so a slider drag costs one recompute per drained batch instead of one per event.
+// Every published version is reported through on_applied (called on the compute thread).
+class MaterialEditQueue
+{
+    struct node
+    {
+        material_edit edit;
+        node *next;
+    };
+
+    MaterialStore &m_store;
+    std::atomic<node *> m_head{nullptr}; // newest first
+    std::atomic<u64> m_pushed{0};
+    std::atomic<u64> m_applied{0};
+
+    std::thread m_thread;
+    std::atomic<bool> m_stop{false};
+    std::atomic<bool> m_sleeping{false};
+    std::mutex m_mutex; // sleeping compute thread and flush() waiters only
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+
+    // drained batch, reused between batches
+    std::vector<material_edit> m_batch;
+    std::vector<u32> m_order; // m_batch indices of surviving edits
+
+    void run()
+    {
+        while (!m_stop.load())
+        {
+            if (process())
+                continue;
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_sleeping.store(true);
+            m_wake.wait(lock, [this] { return m_head.load() != nullptr || m_stop.load(); });
+            m_sleeping.store(false);
+        }
+        process();
+    }
+
+public:
+    // calls the Material::update* method of the edited field
+    static bool apply(Material &mtl, const material_edit &e)
+    {
+        switch (e.field)
+        {
+        case edit_type:
+            return mtl.updateType(u32(e.value[0]));
+        case edit_color:
+            return mtl.updateColor(color3f(e.value[0], e.value[1], e.value[2]));
+        case edit_reflection_factor:
+            return mtl.updateReflectionFactor(e.value[0]);
+        case edit_reflection_coating:
+            return mtl.updateReflectingCoating(e.value[0]);
+        case edit_transparency:
+            return mtl.updateTransparency(e.value[0]);
+        case edit_refractive:
+            return mtl.updateRefractive(e.value[0]);
+        }
+        return false;
+    }
+
+    // material - MaterialStore id, version - the published version
+    std::function<void(u32 material, u32 version)> on_applied;
+
+    explicit MaterialEditQueue(MaterialStore &store)
+        : m_store(store)
+    {
+    }
+
+    ~MaterialEditQueue()
+    {
+        stop();
+        for (node *n = m_head.exchange(nullptr); n;)
+        {
+            node *next = n->next;
+            delete n;
+            n = next;
+        }
+    }
+
+    MaterialEditQueue(const MaterialEditQueue &) = delete;
+    MaterialEditQueue &operator=(const MaterialEditQueue &) = delete;
+
+    void push(const material_edit &edit)
+    {
+        assert(edit.field < edit_fields_count);
+        node *n = new node{edit, m_head.load(std::memory_order_relaxed)};
+        while (!m_head.compare_exchange_weak(n->next, n))
+        {
+        }
+        m_pushed.fetch_add(1);
+
+        if (m_sleeping.load())
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_wake.notify_one();
+        }
+    }
+
+    void push(u32 material, u32 field, float value)
+    {
+        push(material_edit{material, field, {value, 0.0f, 0.0f}});
+    }
+
+    void pushColor(u32 material, const color3f &color)
+    {
+        push(material_edit{material, edit_color, {color.r, color.g, color.b}});
+    }
+
+    // starts the compute thread (or call process() from an own loop)
+    void start()
+    {
+        assert(!m_thread.joinable());
+        m_stop.store(false);
+        m_thread = std::thread([this] { run(); });
+    }
+
+    // applies the edits pushed so far and stops the compute thread
+    void stop()
+    {
+        if (!m_thread.joinable())
+            return;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop.store(true);
+            m_wake.notify_one();
+        }
+        m_thread.join();
+    }
+
+    // applies all pending edits, returns false if there were none
+    // (compute thread only, it must be the only writer of the edited materials)
+    bool process()
+    {
+        node *n = m_head.exchange(nullptr);
+        if (!n)
+            return false;
+
+        // oldest first
+        m_batch.clear();
+        for (; n;)
+        {
+            node *next = n->next;
+            m_batch.push_back(n->edit);
+            delete n;
+            n = next;
+        }
+        std::reverse(m_batch.begin(), m_batch.end());
+        u64 count = m_batch.size();
+
+        // edits of every material in push order, an edit survives unless the next edit of the same
+        // material sets the same field (an edit of another field in between may depend on it,
+        // e.g. transparency is only applied to a transparent type); type edits always survive,
+        // a type change adjusts the other params depending on the old type
+        m_order.resize(m_batch.size());
+        for (u32 i = 0; i < m_order.size(); ++i)
+            m_order[i] = i;
+        std::stable_sort(m_order.begin(), m_order.end(), [this](u32 a, u32 b) { return m_batch[a].material < m_batch[b].material; });
+        size_t kept = 0;
+        for (size_t i = 0; i < m_order.size(); ++i)
+        {
+            const material_edit &e = m_batch[m_order[i]];
+            if (e.field != edit_type && i + 1 < m_order.size() && m_batch[m_order[i + 1]].material == e.material && m_batch[m_order[i + 1]].field == e.field)
+                continue;
+            m_order[kept++] = m_order[i];
+        }
+        m_order.resize(kept);
+
+        u32 size = m_store.getSize();
+        for (size_t begin = 0, end; begin < m_order.size(); begin = end)
+        {
+            u32 material = m_batch[m_order[begin]].material;
+            for (end = begin + 1; end < m_order.size() && m_batch[m_order[end]].material == material; ++end)
+            {
+            }
+            if (material >= size)
+                continue;
+
+            Material mtl = m_store.get(material);
+            bool changed = false;
+            for (size_t i = begin; i < end; ++i)
+                changed |= apply(mtl, m_batch[m_order[i]]);
+            if (!changed)
+                continue;
+
+            u32 version = m_store.publish(material, mtl);
+            if (on_applied)
+                on_applied(material, version);
+        }
+
+        m_applied.fetch_add(count);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_done.notify_all();
+        }
+        return true;
+    }
+
+    // waits until the edits pushed before the call are applied (needs the compute thread)
+    void flush()
+    {
+        u64 target = m_pushed.load();
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [&] { return m_applied.load() >= target; });
+    }
+
+    u64 getPushedCount() const { return m_pushed.load(); }
+    u64 getAppliedCount() const { return m_applied.load(); }
+};
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <vector>
+
+// measured target: linear spectra (e.g. spectrophotometer data projected with spectral_utils::to_rgb)
+struct fit_target
+{
+    u32 type = material_type::painted;
+    color3f diffuse;
+    color3f specular;
+    color3f transmission;
+};
+
+// create() parameters of the best material for a target
+struct fit_result
+{
+    color3f color; ///< sRGB
+    float reflection_factor = 0.0f;
+    float reflection_coating = 0.0f;
+    float transparency = 0.0f;
+    float error = 0.0f; ///< sum of squared spectra differences
+};
+
+// Inverse of Material::create: type constrained parameters that reproduce the target spectra.
+// Closed form seed from the recalcMaterial equations, then a coordinate descent over
+// Material::calcSpectrums for the clamped cases (saturated colors, ReflF > 0.9 ...).
+namespace material_fit
+{
+    static color3f to_color(color3f linear)
+    {
+        float mx = linear.max();
+        if (mx > 0.0f)
+            linear /= mx; // only the chromaticity matters (changeY), brightest color of it
+        material_utils::clamp_zero(linear.r);
+        material_utils::clamp_zero(linear.g);
+        material_utils::clamp_zero(linear.b);
+        return material_utils::from_linear(linear);
+    }
+
+    static bool create(Material &mtl, u32 type, const fit_result &r)
+    {
+        color3f color(r.color);
+        return mtl.create("", "fit", type, color, r.reflection_factor, r.reflection_coating, r.transparency, 1.0f, 0.0f);
+    }
+
+    // spectra create() gives for the parameters (its clamps and Material::calcSpectrums)
+    // without building a Material, the descent evaluates them a few hundred times per sample
+    static void spectra(u32 type, const fit_result &r, color3f &diffuse, color3f &specular, color3f &transmission)
+    {
+        color3f color(r.color), ambient;
+        float ReflF = r.reflection_factor;
+        float ReflC = r.reflection_coating;
+        float Trans = r.transparency;
+        Material::clampParams(color, ReflF, ReflC, Trans);
+        Material::calcSpectrums(type, color, ReflF, ReflC, Trans, diffuse, specular, transmission, ambient);
+    }
+
+    static float error(const fit_target &t, const fit_result &r)
+    {
+        color3f d, s, tr;
+        spectra(t.type, r, d, s, tr);
+        d -= t.diffuse;
+        s -= t.specular;
+        tr -= t.transmission;
+        return (d * d).sum() + (s * s).sum() + (tr * tr).sum();
+    }
+
+    // inverse of Material::recalcMaterial per type, exact when no parameter is clamped
+    static fit_result seed(const fit_target &t)
+    {
+        fit_result r;
+        color3f diffuse(t.diffuse), specular(t.specular), transmission(t.transmission);
+
+        if (t.type == material_type::metallic)
+        {
+            // diff + spec = changeY(color, ReflF), spec / (diff + spec) = ReflC
+            color3f total = diffuse + specular;
+            r.reflection_factor = spectral_utils::to_Y(total);
+            r.reflection_coating = (r.reflection_factor > 0) ? spectral_utils::to_Y(specular) / r.reflection_factor : 0.0f;
+            r.color = to_color(total);
+        }
+        else if (t.type == material_type::painted)
+        {
+            // spec = gray ReflF * ReflC, diff = changeY(color, ReflF) * (1 - ReflC)
+            float s = specular.sum() / 3.0f;
+            r.reflection_factor = spectral_utils::to_Y(diffuse) + s;
+            r.reflection_coating = (r.reflection_factor > 0) ? s / r.reflection_factor : 0.0f;
+            r.color = to_color(diffuse);
+        }
+        else if (t.type == material_type::transparent)
+        {
+            // spec + trans = changeY(color, ReflF + Trans)
+            r.reflection_factor = spectral_utils::to_Y(specular);
+            r.transparency = spectral_utils::to_Y(transmission);
+            r.color = to_color(specular + transmission);
+        }
+
+        material_utils::clamp_value(r.reflection_factor, 0.0f, 0.9f);
+        material_utils::clamp_value(r.reflection_coating, 0.0f, 1.0f);
+        material_utils::clamp_value(r.transparency, 0.0f, 1.0f - r.reflection_factor); // Y <= 1, changeY is undefined above
+        return r;
+    }
+
+    static float &param(fit_result &r, u32 p)
+    {
+        switch (p)
+        {
+        case 0: return r.reflection_factor;
+        case 1: return r.reflection_coating;
+        case 2: return r.transparency;
+        case 3: return r.color.r;
+        case 4: return r.color.g;
+        default: return r.color.b;
+        }
+    }
+
+    // coordinate descent from the seed, only parameters used by the type are searched
+    static fit_result fit(const fit_target &t, u32 iterations = 6)
+    {
+        fit_result best = seed(t);
+        best.error = error(t, best);
+
+        float hi[6] = {0.9f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f};
+        bool used[6] = {true, t.type != material_type::transparent, t.type == material_type::transparent, true, true, true};
+
+        float step = 0.05f;
+        for (u32 it = 0; it < iterations && best.error > 1e-10f; ++it, step *= 0.5f)
+        {
+            for (u32 p = 0; p < 6; ++p)
+            {
+                if (!used[p])
+                    continue;
+
+                for (float dir = -1.0f; dir <= 1.0f; dir += 2.0f)
+                {
+                    fit_result probe = best;
+                    float &v = param(probe, p);
+                    v = std::min(hi[p], std::max(0.0f, v + dir * step));
+                    probe.transparency = std::min(probe.transparency, 1.0f - probe.reflection_factor);
+                    probe.error = error(t, probe);
+                    if (probe.error < best.error)
+                        best = probe;
+                }
+            }
+        }
+        return best;
+    }
+
+    // batch over all samples (e.g. a whole sample book), parallel
+    static void fit(const fit_target *targets, u32 count, fit_result *out, u32 iterations = 6)
+    {
+        parallel_utils::parallel_for(0, count, 64, [&](u32 begin, u32 end)
+        {
+            for (u32 i = begin; i < end; ++i)
+                out[i] = fit(targets[i], iterations);
+        });
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <memory>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// MaterialHandle
+// Shared reference to an immutable material version (flyweight).
+// Copies of a handle share one slot; edit() copies the current version once,
+// applies the change and publishes the result to every holder of the slot.
+class MaterialHandle
+{
+    struct slot
+    {
+        std::shared_ptr<const Material> material;
+        u32 version = 0;
+    };
+
+    std::shared_ptr<slot> m_slot;
+
+    static const Material &defaultMaterial()
+    {
+        static const Material mtl;
+        return mtl;
+    }
+
+public:
+    MaterialHandle() {}
+
+    explicit MaterialHandle(const Material &mtl)
+        : m_slot(std::make_shared<slot>())
+    {
+        m_slot->material = std::make_shared<const Material>(mtl);
+    }
+
+    bool isValid() const { return m_slot != nullptr; }
+
+    const Material &get() const
+    {
+        return m_slot ? *m_slot->material : defaultMaterial();
+    }
+
+    const Material *operator->() const { return &get(); }
+    const Material &operator*() const { return get(); }
+
+    // current version, stays alive while the caller holds it
+    std::shared_ptr<const Material> snapshot() const
+    {
+        return m_slot ? m_slot->material : std::shared_ptr<const Material>();
+    }
+
+    // incremented on every publish
+    u32 getVersion() const { return m_slot ? m_slot->version : 0; }
+
+    // number of handles sharing this material
+    long getUseCount() const { return m_slot.use_count(); }
+
+    void publish(const Material &mtl)
+    {
+        publish(std::make_shared<const Material>(mtl));
+    }
+
+    void publish(std::shared_ptr<const Material> mtl)
+    {
+        assert(mtl);
+        if (!m_slot)
+            m_slot = std::make_shared<slot>();
+
+        m_slot->material = std::move(mtl);
+        ++m_slot->version;
+    }
+
+    // copy-on-write edit
+    // fn - bool(Material&), e.g. [](Material& m) { return m.updateColor(color); }
+    template <class F>
+    bool edit(F fn)
+    {
+        std::shared_ptr<Material> copy = std::make_shared<Material>(get());
+        bool res = fn(*copy);
+        publish(std::shared_ptr<const Material>(std::move(copy)));
+        return res;
+    }
+
+    bool operator==(const MaterialHandle &other) const { return m_slot == other.m_slot; }
+    bool operator!=(const MaterialHandle &other) const { return m_slot != other.m_slot; }
+};
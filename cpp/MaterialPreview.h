@@ -0,0 +1,177 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+// slider range of an edit_field, as the update method clamps it
+static const float *preview_range(u32 field)
+{
+    static const float ranges[edit_fields_count][2] = {
+        {0.0f, 0.0f},  // type
+        {0.0f, 0.0f},  // color
+        {0.0f, 0.9f},  // reflection factor
+        {0.0f, 1.0f},  // reflection coating
+        {0.0f, 1.0f},  // transparency
+        {1.0f, 2.0f}}; // refractive
+    assert(field < edit_fields_count);
+    return ranges[field];
+}
+
+// material state after one slider value
+struct preview_sample
+{
+    float value; ///< slider value (before clamping)
+
+    // params (clamped, dependent ones adjusted as the update method does)
+    float reflection_factor;
+    float reflection_coating;
+    float transparency;
+    float refractive;
+
+    // energetic (linear)
+    color3f diffuse_spectrum;
+    color3f specular_spectrum;
+    color3f transmission_spectrum;
+
+    // graphics (opengl data)
+    material_std140 graphics;
+};
+
+// response of a material over the whole range of one slider
+struct preview_curve
+{
+    u32 field = edit_reflection_factor; ///< edit_field
+    std::vector<preview_sample> samples;
+
+    // nearest sample of a slider value
+    const preview_sample &at(float value) const
+    {
+        assert(!samples.empty());
+        const float *r = preview_range(field);
+        float t = r[1] > r[0] ? (value - r[0]) / (r[1] - r[0]) : 0.0f;
+        material_utils::clamp_value(t, 0.0f, 1.0f);
+        return samples[u32(t * float(samples.size() - 1) + 0.5f)];
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// MaterialPreview
+// Swatches for the material editor sliders.
+// curve() runs the update method of a field for every sample of its range on copies of the material
+// (in parallel) and keeps the result until the handle publishes a new version, so a slider drag over
+// an unchanged material is a table lookup. UI thread only.
+class MaterialPreview
+{
+    struct entry
+    {
+        MaterialHandle material;
+        u32 version;
+        u64 used;
+        preview_curve curve;
+    };
+
+    std::vector<std::unique_ptr<entry>> m_entries;
+    u64 m_clock = 0;
+    u32 m_hits = 0;
+    u32 m_misses = 0;
+
+public:
+    // cached curves, least recently used ones are replaced
+    u32 max_curves = 64;
+
+    static bool isSlider(u32 field)
+    {
+        return field == edit_reflection_factor || field == edit_reflection_coating || field == edit_transparency || field == edit_refractive;
+    }
+
+    // count samples evenly spaced over the range of the field, uncached
+    static void compute(const Material &mtl, u32 field, u32 count, preview_curve &out)
+    {
+        assert(isSlider(field) && count > 1);
+        const float *r = preview_range(field);
+
+        out.field = field;
+        out.samples.resize(count);
+        parallel_utils::parallel_for(0, count, 16, [&](u32 begin, u32 end)
+        {
+            Material m;
+            for (u32 i = begin; i < end; ++i)
+            {
+                preview_sample &s = out.samples[i];
+                s.value = r[0] + (r[1] - r[0]) * float(i) / float(count - 1);
+
+                m = mtl;
+                MaterialEditQueue::apply(m, material_edit{0, field, {s.value, 0.0f, 0.0f}});
+
+                s.reflection_factor = m.getReflectionFactor();
+                s.reflection_coating = m.getReflectionCoating();
+                s.transparency = m.getTransparency();
+                s.refractive = m.getRefractive();
+                s.diffuse_spectrum = m.getDiffuseSpectrum();
+                s.specular_spectrum = m.getSpecularSpectrum();
+                s.transmission_spectrum = m.getTransmissionSpectrum();
+                MaterialBuffer::pack(m, s.graphics);
+            }
+        });
+    }
+
+    // cached curve of the current material version
+    const preview_curve &curve(const MaterialHandle &mtl, u32 field, u32 count = 256)
+    {
+        assert(mtl.isValid());
+        ++m_clock;
+
+        entry *lru = nullptr;
+        for (std::unique_ptr<entry> &e : m_entries)
+        {
+            if (e->material == mtl && e->curve.field == field && e->curve.samples.size() == count)
+            {
+                e->used = m_clock;
+                if (e->version != mtl.getVersion())
+                {
+                    ++m_misses;
+                    e->version = mtl.getVersion();
+                    compute(mtl.get(), field, count, e->curve);
+                }
+                else
+                {
+                    ++m_hits;
+                }
+                return e->curve;
+            }
+            if (!lru || e->used < lru->used)
+                lru = e.get();
+        }
+
+        ++m_misses;
+        if (m_entries.size() < max_curves || !lru)
+        {
+            m_entries.emplace_back(new entry());
+            lru = m_entries.back().get();
+        }
+        lru->material = mtl;
+        lru->version = mtl.getVersion();
+        lru->used = m_clock;
+        compute(mtl.get(), field, count, lru->curve);
+        return lru->curve;
+    }
+
+    // swatch of a slider value
+    const preview_sample &sample(const MaterialHandle &mtl, u32 field, float value, u32 count = 256)
+    {
+        return curve(mtl, field, count).at(value);
+    }
+
+    // drops the curves of a removed material
+    void remove(const MaterialHandle &mtl)
+    {
+        m_entries.erase(std::remove_if(m_entries.begin(), m_entries.end(), [&](const std::unique_ptr<entry> &e) { return e->material == mtl; }),
+                        m_entries.end());
+    }
+
+    void clear() { m_entries.clear(); }
+
+    u32 getHits() const { return m_hits; }
+    u32 getMisses() const { return m_misses; }
+};
@@ -0,0 +1,562 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <cerrno>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#endif
+
+// Binary framing (little endian, the browser reads it with DataView(..., true)):
+//   request  = service_header + records, response = service_header + records
+//   POST /materials : service_material_in[count]                -> service_material_out[count]
+//   POST /color     : service_material_in + service_point[count] -> service_color[count]
+static const u32 service_magic = 0x54414d44; // "DMAT"
+static const u32 service_version = 1;
+
+struct service_header
+{
+    u32 magic = service_magic;
+    u32 version = service_version;
+    u32 count = 0;
+};
+
+typedef material_params service_material_in;
+
+struct service_material_out
+{
+    material_std140 graphics;        ///< DialuxShader uniforms
+    float diffuse_spectrum[3];      ///< linear
+    float specular_spectrum[3];
+    float transmission_spectrum[3];
+    float reflection_factor;        ///< after clamping
+    float reflection_coating;
+    float transparency;
+};
+
+struct service_point
+{
+    float vl[3]; ///< direct illuminance [lx]
+    float vd[3]; ///< diffuse illuminance [lx]
+};
+
+struct service_color
+{
+    float c[3];  ///< luminance color (sRGB)
+    float cg[3]; ///< illuminance gray color (sRGB)
+};
+
+static_assert(sizeof(service_header) == 12 && sizeof(service_material_in) == 36 && sizeof(service_material_out) == 96 &&
+                  sizeof(service_point) == 24 && sizeof(service_color) == 24,
+              "service records are part of the wire format");
+
+namespace service_utils
+{
+#ifdef _WIN32
+    typedef SOCKET socket_t;
+    static const socket_t invalid_socket = INVALID_SOCKET;
+    static void closeSocket(socket_t s) { closesocket(s); }
+#else
+    typedef int socket_t;
+    static const socket_t invalid_socket = -1;
+    static void closeSocket(socket_t s) { close(s); }
+#endif
+
+    static bool startup()
+    {
+#ifdef _WIN32
+        WSADATA wsa;
+        return WSAStartup(MAKEWORD(2, 2), &wsa) == 0;
+#else
+        return true;
+#endif
+    }
+
+    static void setTimeout(socket_t s, u32 ms)
+    {
+#ifdef _WIN32
+        DWORD t = ms;
+#else
+        timeval t;
+        t.tv_sec = ms / 1000;
+        t.tv_usec = (ms % 1000) * 1000;
+#endif
+        setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char *>(&t), sizeof(t));
+        int one = 1;
+        setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char *>(&one), sizeof(one));
+    }
+
+    static bool sendAll(socket_t s, const char *data, size_t size)
+    {
+        while (size)
+        {
+            int n = send(s, data, int(std::min<size_t>(size, 1 << 20)), 0);
+            if (n <= 0)
+                return false;
+            data += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    static void toFloats(const color3f &c, float *out)
+    {
+        out[0] = c.r;
+        out[1] = c.g;
+        out[2] = c.b;
+    }
+
+    // header check, returns the record count or ~0u
+    static u32 records(const std::string &body, size_t prefix, size_t record)
+    {
+        if (body.size() < sizeof(service_header) + prefix)
+            return ~0u;
+
+        service_header h;
+        std::memcpy(&h, body.data(), sizeof(h));
+        if (h.magic != service_magic || h.version != service_version)
+            return ~0u;
+        if (body.size() != sizeof(h) + prefix + size_t(h.count) * record)
+            return ~0u;
+        return h.count;
+    }
+
+    static void writeHeader(std::string &out, u32 count, size_t record)
+    {
+        service_header h;
+        h.count = count;
+        out.resize(sizeof(h) + size_t(count) * record);
+        std::memcpy(&out[0], &h, sizeof(h));
+    }
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// MaterialService
+// Local HTTP/1.1 service for the web editor: the browser posts batches in the binary framing
+// above and gets results computed by Material / PuryaMesh instead of the JS port.
+// One accept thread hands connections to a worker pool; keep-alive connections may send
+// requests back to back (pipelined), they are answered in order.
+class MaterialService
+{
+    service_utils::socket_t m_listen = service_utils::invalid_socket;
+    u32 m_port = 0;
+
+    std::atomic<bool> m_running{false};
+    std::thread m_acceptor;
+    std::vector<std::thread> m_workers;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<service_utils::socket_t> m_queue;
+
+    std::atomic<u32> m_requests{0};
+
+public:
+    static const size_t max_body = size_t(256) << 20;
+    static const u32 receive_timeout = 200; // ms, recv wakes up to re-check m_running
+
+    // a keep-alive connection silent this long is closed, its worker takes the next client
+    u32 idle_timeout = 5000; // ms
+
+    // origin of the editor page allowed to call the service from a browser (e.g. "http://localhost:8080"),
+    // empty - no CORS headers; requests with any other Origin header are refused (set before start)
+    std::string allowed_origin;
+
+    ~MaterialService() { stop(); }
+
+    // port 0 - any free port (see getPort), workers 0 - parallel_utils::thread_count
+    bool start(u32 port = 0, u32 workers = 0, const char *host = "127.0.0.1")
+    {
+        using namespace service_utils;
+
+        if (m_running || !startup())
+            return false;
+
+        m_listen = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (m_listen == invalid_socket)
+            return false;
+
+        int one = 1;
+        setsockopt(m_listen, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&one), sizeof(one));
+
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(u16_port(port));
+        inet_pton(AF_INET, host, &addr.sin_addr);
+
+        socklen_t len = sizeof(addr);
+        if (bind(m_listen, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || listen(m_listen, 64) != 0 ||
+            getsockname(m_listen, reinterpret_cast<sockaddr *>(&addr), &len) != 0)
+        {
+            closeSocket(m_listen);
+            m_listen = invalid_socket;
+            return false;
+        }
+        m_port = ntohs(addr.sin_port);
+
+        m_running = true;
+        if (!workers)
+            workers = parallel_utils::thread_count();
+        for (u32 i = 0; i < workers; ++i)
+            m_workers.emplace_back([this]() { work(); });
+        m_acceptor = std::thread([this]() { accept(); });
+        return true;
+    }
+
+    void stop()
+    {
+        if (!m_running.exchange(false))
+            return;
+
+        m_cv.notify_all();
+        m_acceptor.join();
+        for (std::thread &t : m_workers)
+            t.join();
+        m_workers.clear();
+
+        for (service_utils::socket_t s : m_queue)
+            service_utils::closeSocket(s);
+        m_queue.clear();
+        service_utils::closeSocket(m_listen);
+        m_listen = service_utils::invalid_socket;
+    }
+
+    u32 getPort() const { return m_port; }
+    u32 getRequestsCount() const { return m_requests; }
+
+    // transport independent entry point, returns the HTTP status
+    static int handle(const std::string &method, const std::string &path, const std::string &body, std::string &out)
+    {
+        using namespace service_utils;
+        out.clear();
+
+        if (method != "POST")
+            return 405;
+
+        if (path == "/materials")
+        {
+            u32 count = records(body, 0, sizeof(service_material_in));
+            if (count == ~0u)
+                return 400;
+
+            writeHeader(out, count, sizeof(service_material_out));
+            const char *src = body.data() + sizeof(service_header);
+            char *dst = &out[0] + sizeof(service_header);
+
+            Material mtl;
+            for (u32 i = 0; i < count; ++i)
+            {
+                service_material_in in;
+                std::memcpy(&in, src + size_t(i) * sizeof(in), sizeof(in));
+                if (!material_batch::create(in, mtl, "service"))
+                {
+                    out.clear();
+                    return 400;
+                }
+
+                service_material_out r;
+                MaterialBuffer::pack(mtl, r.graphics);
+                toFloats(mtl.getDiffuseSpectrum(), r.diffuse_spectrum);
+                toFloats(mtl.getSpecularSpectrum(), r.specular_spectrum);
+                toFloats(mtl.getTransmissionSpectrum(), r.transmission_spectrum);
+                r.reflection_factor = mtl.getReflectionFactor();
+                r.reflection_coating = mtl.getReflectionCoating();
+                r.transparency = mtl.getTransparency();
+                std::memcpy(dst + size_t(i) * sizeof(r), &r, sizeof(r));
+            }
+            return 200;
+        }
+
+        if (path == "/color")
+        {
+            u32 count = records(body, sizeof(service_material_in), sizeof(service_point));
+            if (count == ~0u)
+                return 400;
+
+            service_material_in in;
+            std::memcpy(&in, body.data() + sizeof(service_header), sizeof(in));
+            Material mtl;
+            if (!material_batch::create(in, mtl, "service"))
+                return 400;
+            color3f cd = mtl.getDiffuseSpectrum();
+
+            writeHeader(out, count, sizeof(service_color));
+            const char *src = body.data() + sizeof(service_header) + sizeof(in);
+            char *dst = &out[0] + sizeof(service_header);
+
+            for (u32 i = 0; i < count; ++i)
+            {
+                service_point p;
+                std::memcpy(&p, src + size_t(i) * sizeof(p), sizeof(p));
+
+                color4f c, cg;
+                PuryaMesh::colorPoint(color3f(p.vl[0] + p.vd[0], p.vl[1] + p.vd[1], p.vl[2] + p.vd[2]), cd, c, cg);
+
+                service_color r;
+                toFloats(c, r.c);
+                toFloats(cg, r.cg);
+                std::memcpy(dst + size_t(i) * sizeof(r), &r, sizeof(r));
+            }
+            return 200;
+        }
+
+        return 404;
+    }
+
+    // blocking localhost client (tests, tools): POST body to path, returns the HTTP status or 0
+    static int request(u32 port, const char *path, const std::string &body, std::string &response)
+    {
+        using namespace service_utils;
+
+        if (!startup())
+            return 0;
+
+        socket_t s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(u16_port(port));
+        inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+        if (s == invalid_socket || connect(s, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0)
+        {
+            if (s != invalid_socket)
+                closeSocket(s);
+            return 0;
+        }
+
+        std::string head = std::string("POST ") + path + " HTTP/1.1\r\nHost: localhost\r\nContent-Type: application/octet-stream\r\nContent-Length: " +
+                           std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n";
+
+        int status = 0;
+        std::string buffer;
+        if (sendAll(s, head.data(), head.size()) && sendAll(s, body.data(), body.size()))
+        {
+            std::string method, uri;
+            size_t length = 0;
+            bool keep_alive = false;
+            if (readHead(s, buffer, method, uri, length, keep_alive) && readBody(s, buffer, length, response))
+                status = std::atoi(uri.c_str()); // status line: "HTTP/1.1 200 OK"
+        }
+        closeSocket(s);
+        return status;
+    }
+
+private:
+    static unsigned short u16_port(u32 port) { return static_cast<unsigned short>(port); }
+
+    void accept()
+    {
+        using namespace service_utils;
+
+        while (m_running)
+        {
+            fd_set set;
+            FD_ZERO(&set);
+            FD_SET(m_listen, &set);
+            timeval t = {0, 100000}; // re-check m_running
+            if (select(int(m_listen + 1), &set, nullptr, nullptr, &t) <= 0)
+                continue;
+
+            socket_t s = ::accept(m_listen, nullptr, nullptr);
+            if (s == invalid_socket)
+                continue;
+            setTimeout(s, receive_timeout);
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_queue.push_back(s);
+            m_cv.notify_one();
+        }
+    }
+
+    void work()
+    {
+        while (true)
+        {
+            service_utils::socket_t s;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cv.wait(lock, [this]() { return !m_queue.empty() || !m_running; });
+                if (!m_running)
+                    return;
+                s = m_queue.front();
+                m_queue.pop_front();
+            }
+            serve(s);
+            service_utils::closeSocket(s);
+        }
+    }
+
+    // keep-alive loop, bytes past one request stay in buffer for the next (pipelining)
+    void serve(service_utils::socket_t s)
+    {
+        std::string buffer, body, out;
+        while (m_running)
+        {
+            std::string method, path, origin;
+            size_t length = 0;
+            bool keep_alive = false;
+            if (!readHead(s, buffer, method, path, length, keep_alive, &m_running, idle_timeout, &origin))
+                return;
+
+            if (length > max_body)
+            {
+                reply(s, 413, out, false);
+                return;
+            }
+            if (!readBody(s, buffer, length, body, &m_running, idle_timeout))
+                return;
+
+            // browsers send Origin, other pages must not drive the service
+            bool cors = !origin.empty() && origin == allowed_origin;
+            int status;
+            if (!origin.empty() && !cors)
+            {
+                out.clear();
+                status = 403;
+            }
+            else if (method == "OPTIONS") // CORS preflight from the editor page
+            {
+                out.clear();
+                status = 204;
+            }
+            else
+                status = handle(method, path, body, out);
+
+            ++m_requests;
+            if (!reply(s, status, out, keep_alive, cors ? origin : std::string()) || !keep_alive)
+                return;
+        }
+    }
+
+    // origin - allowed Origin of the request, empty - no CORS headers
+    static bool reply(service_utils::socket_t s, int status, const std::string &body, bool keep_alive, const std::string &origin = std::string())
+    {
+        const char *reason = (status == 200) ? "OK" : (status == 204) ? "No Content" : (status == 400) ? "Bad Request" : (status == 403) ? "Forbidden" : (status == 404) ? "Not Found" : (status == 405) ? "Method Not Allowed" : "Payload Too Large";
+        std::string head = "HTTP/1.1 " + std::to_string(status) + " " + reason +
+                           "\r\nContent-Type: application/octet-stream\r\nContent-Length: " + std::to_string(body.size()) + "\r\n";
+        if (!origin.empty())
+            head += "Access-Control-Allow-Origin: " + origin + "\r\nAccess-Control-Allow-Methods: POST, OPTIONS\r\nAccess-Control-Allow-Headers: Content-Type\r\nVary: Origin\r\n";
+        head += std::string("Connection: ") + (keep_alive ? "keep-alive" : "close") + "\r\n\r\n";
+        return service_utils::sendAll(s, head.data(), head.size()) && service_utils::sendAll(s, body.data(), body.size());
+    }
+
+    // recv more into buffer, timeouts only retry while running (nullptr - until the peer closes)
+    // and for at most idle ms (0 - no limit)
+    static bool receive(service_utils::socket_t s, std::string &buffer, const std::atomic<bool> *running, u32 idle = 0)
+    {
+        char chunk[1 << 16];
+        for (u32 waited = 0;; waited += receive_timeout)
+        {
+            if (idle && waited >= idle)
+                return false;
+
+            int n = recv(s, chunk, sizeof(chunk), 0);
+            if (n > 0)
+            {
+                buffer.append(chunk, n);
+                return true;
+            }
+            if (n == 0 || !running || !*running)
+                return false;
+#ifdef _WIN32
+            if (WSAGetLastError() != WSAETIMEDOUT)
+                return false;
+#else
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                return false;
+#endif
+        }
+    }
+
+    // request or status line + headers; first = method (or "HTTP/1.1"), second = path (or status),
+    // keep_alive - HTTP/1.1 unless "Connection: close", HTTP/1.0 only with "Connection: keep-alive",
+    // origin - optional, the Origin header (empty if none)
+    static bool readHead(service_utils::socket_t s, std::string &buffer, std::string &first, std::string &second, size_t &length, bool &keep_alive,
+                         const std::atomic<bool> *running = nullptr, u32 idle = 0, std::string *origin = nullptr)
+    {
+        size_t end;
+        while ((end = buffer.find("\r\n\r\n")) == std::string::npos)
+        {
+            if (buffer.size() > 64 * 1024 || !receive(s, buffer, running, idle))
+                return false;
+        }
+
+        std::string head = buffer.substr(0, end);
+        buffer.erase(0, end + 4);
+
+        size_t sp1 = head.find(' ');
+        size_t sp2 = head.find_first_of(" \r", sp1 + 1);
+        if (sp1 == std::string::npos)
+            return false;
+        first = head.substr(0, sp1);
+        second = head.substr(sp1 + 1, sp2 - sp1 - 1);
+
+        size_t eol = head.find("\r\n");
+        keep_alive = head.substr(0, eol).find("HTTP/1.1") != std::string::npos; // request or status line
+        length = 0;
+        if (origin)
+            origin->clear();
+        for (size_t pos = head.find("\r\n"); pos != std::string::npos;)
+        {
+            size_t next = head.find("\r\n", pos + 2);
+            std::string line = head.substr(pos + 2, next - pos - 2);
+            std::string value = line;
+            for (char &ch : line)
+                ch = char(tolower(ch));
+
+            if (line.compare(0, 15, "content-length:") == 0)
+                length = size_t(std::strtoull(line.c_str() + 15, nullptr, 10));
+            else if (line.compare(0, 11, "connection:") == 0)
+            {
+                if (line.find("close") != std::string::npos)
+                    keep_alive = false;
+                else if (line.find("keep-alive") != std::string::npos)
+                    keep_alive = true;
+            }
+            else if (origin && line.compare(0, 7, "origin:") == 0)
+            {
+                size_t b = value.find_first_not_of(' ', 7);
+                *origin = (b == std::string::npos) ? std::string() : value.substr(b, value.find_last_not_of(' ') + 1 - b);
+            }
+            pos = next;
+        }
+        return true;
+    }
+
+    static bool readBody(service_utils::socket_t s, std::string &buffer, size_t length, std::string &body, const std::atomic<bool> *running = nullptr,
+                         u32 idle = 0)
+    {
+        while (buffer.size() < length)
+        {
+            if (!receive(s, buffer, running, idle))
+                return false;
+        }
+        body.assign(buffer, 0, length);
+        buffer.erase(0, length);
+        return true;
+    }
+};
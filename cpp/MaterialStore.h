@@ -0,0 +1,241 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// MaterialStore
+// Materials shared between the editor and render / coloring threads.
+// Every material is an immutable version published with one atomic pointer swap, so a reader
+// never sees a half-updated material. Readers hold a MaterialStore::reader (no locks, no
+// reference counting per access): versions they may see are freed only after every reader
+// that entered before the swap has left (epoch based reclamation).
+// Writers are serialized by a mutex, readers do not wait for them.
+class MaterialStore
+{
+    struct node
+    {
+        Material material;
+        u32 version;
+        u64 retired; // epoch of the swap that replaced this version
+    };
+
+    struct entry
+    {
+        std::atomic<node *> current{nullptr};
+    };
+
+    // reader epoch, 0 - free slot
+    struct alignas(64) slot
+    {
+        std::atomic<u64> epoch{0};
+    };
+
+    static const u32 block_size = 1024;
+    static const u32 max_blocks = 4096;
+    static const u32 max_readers = 64;
+    static const u32 reclaim_batch = 64;
+
+    std::atomic<entry *> m_blocks[max_blocks] = {};
+    std::atomic<u32> m_size{0};
+    std::atomic<u64> m_epoch{1};
+    mutable slot m_readers[max_readers]; // readers register in a const store
+
+    std::mutex m_mutex; // writers
+    std::vector<node *> m_retired;
+
+    const entry &at(u32 id) const
+    {
+        return m_blocks[id / block_size].load(std::memory_order_acquire)[id % block_size];
+    }
+
+    entry &at(u32 id)
+    {
+        return m_blocks[id / block_size].load(std::memory_order_relaxed)[id % block_size];
+    }
+
+    u64 minReaderEpoch() const
+    {
+        u64 res = ~u64(0);
+        for (const slot &s : m_readers)
+        {
+            u64 e = s.epoch.load();
+            if (e && e < res)
+                res = e;
+        }
+        return res;
+    }
+
+    // frees retired versions no reader can see, m_mutex held
+    void reclaimLocked()
+    {
+        u64 min = minReaderEpoch();
+        size_t n = 0;
+        for (node *p : m_retired)
+        {
+            if (p->retired < min)
+                delete p;
+            else
+                m_retired[n++] = p;
+        }
+        m_retired.resize(n);
+    }
+
+    // m_mutex held
+    u32 publishLocked(u32 id, const Material &mtl)
+    {
+        entry &e = at(id);
+        node *old = e.current.load(std::memory_order_relaxed);
+        node *p = new node{mtl, old->version + 1, 0};
+        e.current.store(p);
+
+        // readers entering after the increment load p
+        old->retired = m_epoch.fetch_add(1);
+        m_retired.push_back(old);
+        if (m_retired.size() >= reclaim_batch)
+            reclaimLocked();
+        return p->version;
+    }
+
+public:
+    /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+    // reader
+    // Read section: materials returned by get() stay valid until the reader is destroyed.
+    // Keep it short (one frame / one coloring task), long sections delay reclamation.
+    class reader
+    {
+        const MaterialStore &m_store;
+        slot *m_slot;
+
+    public:
+        explicit reader(const MaterialStore &store)
+            : m_store(store), m_slot(nullptr)
+        {
+            u32 i = u32(std::hash<std::thread::id>()(std::this_thread::get_id()) % max_readers);
+            for (;;)
+            {
+                for (u32 n = 0; n < max_readers; ++n, i = (i + 1) % max_readers)
+                {
+                    slot &s = store.m_readers[i];
+                    u64 expected = 0;
+                    if (s.epoch.load(std::memory_order_relaxed) == 0 && s.epoch.compare_exchange_strong(expected, store.m_epoch.load()))
+                    {
+                        m_slot = &s;
+                        return;
+                    }
+                }
+                std::this_thread::yield(); // more than max_readers concurrent readers
+            }
+        }
+
+        ~reader() { m_slot->epoch.store(0, std::memory_order_release); }
+
+        reader(const reader &) = delete;
+        reader &operator=(const reader &) = delete;
+
+        u32 getSize() const { return m_store.getSize(); }
+
+        const Material &get(u32 id) const
+        {
+            assert(id < getSize());
+            return m_store.at(id).current.load()->material;
+        }
+
+        const Material &operator[](u32 id) const { return get(id); }
+
+        // version of the material get(id) returns now
+        u32 getVersion(u32 id) const
+        {
+            assert(id < getSize());
+            return m_store.at(id).current.load()->version;
+        }
+    };
+
+    MaterialStore() {}
+
+    ~MaterialStore()
+    {
+        for (node *p : m_retired)
+            delete p;
+
+        u32 size = m_size.load();
+        for (u32 id = 0; id < size; ++id)
+            delete at(id).current.load();
+        for (std::atomic<entry *> &b : m_blocks)
+            delete[] b.load();
+    }
+
+    MaterialStore(const MaterialStore &) = delete;
+    MaterialStore &operator=(const MaterialStore &) = delete;
+
+    u32 getSize() const { return m_size.load(std::memory_order_acquire); }
+
+    // returns the id of the new material, version 1
+    u32 add(const Material &mtl)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        u32 id = m_size.load(std::memory_order_relaxed);
+        assert(id < block_size * max_blocks);
+
+        std::atomic<entry *> &block = m_blocks[id / block_size];
+        if (!block.load(std::memory_order_relaxed))
+            block.store(new entry[block_size], std::memory_order_release);
+
+        at(id).current.store(new node{mtl, 1, 0}, std::memory_order_release);
+        m_size.store(id + 1, std::memory_order_release);
+        return id;
+    }
+
+    // replaces the material, returns the new version
+    u32 publish(u32 id, const Material &mtl)
+    {
+        assert(id < getSize());
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return publishLocked(id, mtl);
+    }
+
+    // copy-on-write edit
+    // fn - bool(Material&), e.g. [](Material& m) { return m.updateColor(color); }
+    // the edited copy is published only when fn succeeds
+    template <class F>
+    bool edit(u32 id, F fn)
+    {
+        assert(id < getSize());
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Material copy = at(id).current.load(std::memory_order_relaxed)->material;
+        if (!fn(copy))
+            return false;
+        publishLocked(id, copy);
+        return true;
+    }
+
+    // copy of the current version (writer side)
+    Material get(u32 id) const
+    {
+        reader r(*this);
+        return r.get(id);
+    }
+
+    u32 getVersion(u32 id) const
+    {
+        reader r(*this);
+        return r.getVersion(id);
+    }
+
+    // frees retired versions now (publish does it every reclaim_batch versions)
+    void reclaim()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        reclaimLocked();
+    }
+
+    // versions waiting for readers to leave
+    size_t getRetiredCount()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_retired.size();
+    }
+};
@@ -0,0 +1,468 @@
+#pragma once
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Photometry
+// Luminous intensity distribution I(C, gamma) [cd] of a luminaire (type C photometry),
+// loaded from EULUMDAT (.ldt) or IES LM-63 (.ies) and resampled to a uniform
+// 1 x 1 degree table (C 0..360, gamma 0..180) for fast bilinear lookup.
+class Photometry
+{
+    static const u32 nc = 361; // C 0..360
+    static const u32 ng = 181; // gamma 0..180
+
+    std::vector<float> m_table; // [c][gamma] [cd]
+    float m_flux = 0.0f;        ///< luminous flux of lamps [lm]
+    std::string m_name;
+
+public:
+    bool isValid() const { return !m_table.empty(); }
+    const std::string &getName() const { return m_name; }
+    const float &getFlux() const { return m_flux; }
+
+    bool load(const char *file_name)
+    {
+        std::string name(file_name);
+        std::ifstream in(file_name);
+        if (!in)
+            return false;
+
+        std::stringstream buff;
+        buff << in.rdbuf();
+
+        std::string ext = name.substr(name.find_last_of('.') + 1);
+        for (char &ch : ext)
+            ch = char(tolower(ch));
+
+        return (ext == "ies") ? loadIES(buff.str()) : loadLDT(buff.str());
+    }
+
+    // EULUMDAT, intensities in cd/klm are scaled by the lamp flux
+    bool loadLDT(const std::string &text)
+    {
+        std::istringstream in(text);
+        std::vector<std::string> lines;
+        std::string line;
+        while (std::getline(in, line))
+        {
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            lines.push_back(line);
+        }
+
+        if (lines.size() < 26)
+            return false;
+
+        u32 isym = u32(toFloat(lines[2]));
+        u32 mc = u32(toFloat(lines[3]));
+        u32 ngamma = u32(toFloat(lines[5]));
+        u32 sets = u32(toFloat(lines[25]));
+        m_name = lines[8];
+
+        u32 pos = 26;
+        m_flux = 0.0f;
+        for (u32 i = 0; i < sets; ++i)
+        {
+            if (pos + 6 > lines.size())
+                return false;
+            m_flux += toFloat(lines[pos + 2]); // total luminous flux of lamp set
+            pos += 6;
+        }
+        pos += 10; // direct ratios
+
+        u32 planes = 0;
+        switch (isym)
+        {
+        case 0: planes = mc; break;
+        case 1: planes = 1; break;
+        case 2: planes = mc / 2 + 1; break;
+        case 3: planes = mc / 2 + 1; break;
+        case 4: planes = mc / 4 + 1; break;
+        default: return false;
+        }
+
+        if (!mc || !ngamma || pos + mc + ngamma + planes * ngamma > lines.size())
+            return false;
+
+        std::vector<float> c_angles(mc);
+        for (u32 i = 0; i < mc; ++i)
+            c_angles[i] = toFloat(lines[pos++]);
+
+        std::vector<float> g_angles(ngamma);
+        for (u32 i = 0; i < ngamma; ++i)
+            g_angles[i] = toFloat(lines[pos++]);
+
+        // first stored plane: C0 for isym 0, 1, 2, 4 and C270 for isym 3
+        u32 first = (isym == 3) ? mc * 3 / 4 : 0;
+        std::vector<float> planes_c(planes);
+        for (u32 i = 0; i < planes; ++i)
+            planes_c[i] = c_angles[(first + i) % mc];
+
+        std::vector<float> values(size_t(planes) * ngamma);
+        float klm = m_flux / 1000.0f;
+        for (size_t i = 0; i < values.size(); ++i)
+            values[i] = toFloat(lines[pos++]) * klm;
+
+        // full distribution: close the circle with C360 = C0
+        if (isym == 0 && planes_c.back() < 360.0f)
+        {
+            planes_c.push_back(360.0f);
+            values.insert(values.end(), values.begin(), values.begin() + ngamma);
+        }
+
+        return resample(isym, planes_c, g_angles, values);
+    }
+
+    // IES LM-63 (1995, 2002), TILT=INCLUDE data is skipped
+    bool loadIES(const std::string &text)
+    {
+        std::istringstream in(text);
+        std::string line;
+        m_name.clear();
+
+        while (std::getline(in, line))
+        {
+            if (line.compare(0, 8, "[LUMINAI") == 0 || line.compare(0, 8, "[LUMCAT]") == 0)
+                m_name = line.substr(line.find(']') + 1);
+            if (line.compare(0, 5, "TILT=") == 0)
+                break;
+        }
+        if (!in)
+            return false;
+
+        if (line.find("INCLUDE") != std::string::npos)
+        {
+            float geometry, pairs;
+            in >> geometry >> pairs;
+            for (u32 i = 0; i < 2 * u32(pairs); ++i)
+            {
+                float skip;
+                in >> skip;
+            }
+        }
+
+        float lamps, lumens, multiplier, nvert, nhoriz, type, units, width, length, height, ballast, future, watts;
+        in >> lamps >> lumens >> multiplier >> nvert >> nhoriz >> type >> units >> width >> length >> height;
+        in >> ballast >> future >> watts;
+        if (!in || nvert < 1 || nhoriz < 1 || type != 1)
+            return false;
+
+        std::vector<float> g_angles(static_cast<size_t>(nvert));
+        std::vector<float> c_angles(static_cast<size_t>(nhoriz));
+        for (float &a : g_angles)
+            in >> a;
+        for (float &a : c_angles)
+            in >> a;
+
+        std::vector<float> values(c_angles.size() * g_angles.size());
+        for (float &v : values)
+        {
+            in >> v;
+            v *= multiplier * ballast;
+        }
+        if (!in)
+            return false;
+
+        m_flux = (lumens > 0) ? lamps * lumens : 0.0f; // -1 - absolute photometry
+
+        // horizontal angles: 0 (full symmetry), 0..90 (quadrant), 0..180 (bilateral about C0-C180),
+        // 90..270 (bilateral about C90-C270), 0..360
+        float first = c_angles.front(), last = c_angles.back();
+        u32 isym = (c_angles.size() == 1) ? 1 : (first >= 90.0f && last <= 270.0f) ? 3 : (last <= 90.0f) ? 4 : (last <= 180.0f) ? 2 : 0;
+        if (isym == 3)
+        {
+            // mirror the C90..C270 half to C270..C90 (through C0) as stored by EULUMDAT isym 3
+            size_t ngm = g_angles.size();
+            std::vector<float> mirrored(values.size());
+            for (size_t i = 0, n = c_angles.size(); i < n; ++i)
+                std::copy(values.begin() + (n - 1 - i) * ngm, values.begin() + (n - i) * ngm, mirrored.begin() + i * ngm);
+            values.swap(mirrored);
+
+            std::reverse(c_angles.begin(), c_angles.end());
+            for (float &a : c_angles)
+                a = (a > 180.0f) ? 540.0f - a : 180.0f - a;
+        }
+        if (isym == 0 && last < 360.0f)
+        {
+            c_angles.push_back(360.0f);
+            values.insert(values.end(), values.begin(), values.begin() + g_angles.size());
+        }
+
+        return resample(isym, c_angles, g_angles, values);
+    }
+
+    // bilinear lookup, c / gamma [deg]
+    float getIntensity(float c, float gamma) const
+    {
+        c = std::min(std::max(c, 0.0f), 360.0f);
+        gamma = std::min(std::max(gamma, 0.0f), 180.0f);
+
+        u32 ci = std::min(u32(c), nc - 2);
+        u32 gi = std::min(u32(gamma), ng - 2);
+        float fc = c - ci;
+        float fg = gamma - gi;
+
+        const float *t0 = m_table.data() + size_t(ci) * ng + gi;
+        const float *t1 = t0 + ng;
+        return (t0[0] * (1.0f - fg) + t0[1] * fg) * (1.0f - fc) + (t1[0] * (1.0f - fg) + t1[1] * fg) * fc;
+    }
+
+    // uniform table from explicit values, f(c, gamma) [cd]
+    template <class F>
+    void create(F f, float flux = 0.0f)
+    {
+        m_flux = flux;
+        m_table.resize(size_t(nc) * ng);
+        for (u32 c = 0; c < nc; ++c)
+            for (u32 g = 0; g < ng; ++g)
+                m_table[size_t(c) * ng + g] = f(float(c), float(g));
+    }
+
+private:
+    static float toFloat(const std::string &s)
+    {
+        std::string v(s);
+        std::replace(v.begin(), v.end(), ',', '.');
+        return float(atof(v.c_str()));
+    }
+
+    // index of interval [a[i], a[i + 1]] containing x and the fraction inside it
+    static void locate(const std::vector<float> &a, float x, u32 &i, float &f)
+    {
+        if (a.size() < 2 || x <= a.front())
+        {
+            i = 0;
+            f = 0.0f;
+            return;
+        }
+        if (x >= a.back())
+        {
+            i = u32(a.size() - 2);
+            f = 1.0f;
+            return;
+        }
+        i = u32(std::upper_bound(a.begin(), a.end(), x) - a.begin() - 1);
+        float d = a[i + 1] - a[i];
+        f = (d > 0) ? (x - a[i]) / d : 0.0f;
+    }
+
+    // values - [plane][gamma], isym - EULUMDAT symmetry code
+    bool resample(u32 isym, const std::vector<float> &c_angles, const std::vector<float> &g_angles, const std::vector<float> &values)
+    {
+        u32 ngm = u32(g_angles.size());
+        u32 planes = u32(c_angles.size());
+        if (!planes || !ngm || values.size() < size_t(planes) * ngm)
+            return false;
+
+        auto sample = [&](u32 p, float g)
+        {
+            // no light outside the measured gamma range (e.g. 0..90 for downlights)
+            if (g < g_angles.front() || g > g_angles.back())
+                return 0.0f;
+
+            u32 gi;
+            float fg;
+            locate(g_angles, g, gi, fg);
+            const float *v = values.data() + size_t(p) * ngm;
+            return (ngm > 1) ? v[gi] * (1.0f - fg) + v[gi + 1] * fg : v[0];
+        };
+
+        // isym 3 stores C270..C90 through C0, as -90..90
+        std::vector<float> ca(c_angles);
+        if (isym == 3)
+        {
+            for (float &a : ca)
+                a = (a >= 270.0f) ? a - 360.0f : a;
+        }
+
+        m_table.resize(size_t(nc) * ng);
+        for (u32 c = 0; c < nc; ++c)
+        {
+            // fold C into the stored range
+            float cc = float(c);
+            switch (isym)
+            {
+            case 1: cc = 0.0f; break;
+            case 2: cc = (cc > 180.0f) ? 360.0f - cc : cc; break;
+            case 3: cc = (cc > 90.0f && cc < 270.0f) ? 180.0f - cc : (cc >= 270.0f) ? cc - 360.0f : cc; break;
+            case 4: cc = (cc > 180.0f) ? 360.0f - cc : cc; cc = (cc > 90.0f) ? 180.0f - cc : cc; break;
+            }
+
+            u32 ci = 0;
+            float fc = 0.0f;
+            if (planes > 1)
+                locate(ca, cc, ci, fc);
+
+            for (u32 g = 0; g < ng; ++g)
+            {
+                float v0 = sample(ci, float(g));
+                float v1 = (planes > 1) ? sample(ci + 1, float(g)) : v0;
+                m_table[size_t(c) * ng + g] = v0 * (1.0f - fc) + v1 * fc;
+            }
+        }
+        return true;
+    }
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Luminaire
+// Placed photometry: local -Z is gamma 0 (nadir), local +X is C0, local +Y is C90.
+struct Luminaire
+{
+    const Photometry *photometry = nullptr;
+
+    vec3f position;
+    vec3f axis_x = vec3f(1.0f, 0.0f, 0.0f);
+    vec3f axis_y = vec3f(0.0f, 1.0f, 0.0f);
+    vec3f axis_z = vec3f(0.0f, 0.0f, 1.0f);
+
+    color3f color = color3f(1.0f); ///< light color (linear)
+    float dimming = 1.0f;          ///< intensity multiplier [0, 1]
+
+    // angles [deg], rotation Rz(yaw) * Ry(pitch) * Rx(roll)
+    void setRotation(float yaw, float pitch, float roll)
+    {
+        const float d = mesh_utils::PI / 180.0f;
+        float cy = cos(yaw * d), sy = sin(yaw * d);
+        float cp = cos(pitch * d), sp = sin(pitch * d);
+        float cr = cos(roll * d), sr = sin(roll * d);
+
+        axis_x.set(cy * cp, sy * cp, -sp);
+        axis_y.set(cy * sp * sr - sy * cr, sy * sp * sr + cy * cr, cp * sr);
+        axis_z.set(cy * sp * cr + sy * sr, sy * sp * cr - cy * sr, cp * cr);
+    }
+};
+
+namespace light_utils
+{
+    static const float RAD2DEG = 57.2957795130823209f;
+
+    // |error| < 1e-5 rad, branch free (vectorizable)
+    static float fast_atan(float x)
+    {
+        // x in [-1, 1]
+        float x2 = x * x;
+        return x * (0.99997726f + x2 * (-0.33262347f + x2 * (0.19354346f + x2 * (-0.11643287f + x2 * (0.05265332f + x2 * -0.01172120f)))));
+    }
+
+    // degrees [0, 360)
+    static float fast_atan2_deg(float y, float x)
+    {
+        float ax = std::abs(x), ay = std::abs(y);
+        float mx = std::max(ax, ay);
+        float mn = std::min(ax, ay);
+        float a = fast_atan(mx > 0.0f ? mn / mx : 0.0f);
+        a = (ay > ax) ? 1.57079637f - a : a;
+        a = (x < 0.0f) ? 3.14159274f - a : a;
+        a = (y < 0.0f) ? 6.28318548f - a : a;
+        return a * RAD2DEG;
+    }
+
+    // degrees [0, 180]
+    static float fast_acos_deg(float x)
+    {
+        x = std::min(std::max(x, -1.0f), 1.0f);
+        float s = std::sqrt(std::max(0.0f, 1.0f - x * x));
+        return fast_atan2_deg(s, x);
+    }
+
+    // E [lx] at count points (SoA positions and normals), no occlusion:
+    //   E = sum I(C, gamma) * cos(incidence) / r^2
+    // out - color3f per point (light color * E), accumulated when add == true
+    static void direct_illuminance(const Luminaire *luminaires, u32 l_count,
+                                   const float *px, const float *py, const float *pz,
+                                   const float *nx, const float *ny, const float *nz,
+                                   u32 count, color3f *out, bool add = false)
+    {
+        static const u32 block = 256;
+
+        parallel_utils::parallel_for(0, count, block, [&](u32 begin, u32 end)
+        {
+            float c[block], g[block], w[block];
+            u32 n = end - begin;
+
+            float er[block] = {0}, eg[block] = {0}, eb[block] = {0};
+
+            for (u32 l = 0; l < l_count; ++l)
+            {
+                const Luminaire &lum = luminaires[l];
+                if (!lum.photometry || !lum.photometry->isValid() || lum.dimming <= 0.0f)
+                    continue;
+
+                const vec3f &o = lum.position;
+                const vec3f &ax = lum.axis_x, &ay = lum.axis_y, &az = lum.axis_z;
+
+                // geometry: vectorizable
+                for (u32 k = 0; k < n; ++k)
+                {
+                    u32 i = begin + k;
+                    float dx = px[i] - o.x, dy = py[i] - o.y, dz = pz[i] - o.z;
+                    float r2 = std::max(dx * dx + dy * dy + dz * dz, 1e-8f);
+                    float inv = 1.0f / std::sqrt(r2);
+                    dx *= inv;
+                    dy *= inv;
+                    dz *= inv;
+
+                    float lx = dx * ax.x + dy * ax.y + dz * ax.z;
+                    float ly = dx * ay.x + dy * ay.y + dz * ay.z;
+                    float lz = dx * az.x + dy * az.y + dz * az.z;
+
+                    float cos_i = -(dx * nx[i] + dy * ny[i] + dz * nz[i]);
+                    w[k] = std::max(cos_i, 0.0f) / r2;
+                    c[k] = fast_atan2_deg(ly, lx);
+                    g[k] = fast_acos_deg(-lz);
+                }
+
+                // table lookup
+                float scale = lum.dimming;
+                for (u32 k = 0; k < n; ++k)
+                {
+                    float e = (w[k] > 0.0f) ? lum.photometry->getIntensity(c[k], g[k]) * w[k] * scale : 0.0f;
+                    er[k] += e * lum.color.r;
+                    eg[k] += e * lum.color.g;
+                    eb[k] += e * lum.color.b;
+                }
+            }
+
+            for (u32 k = 0; k < n; ++k)
+            {
+                color3f &e = out[begin + k];
+                if (add)
+                    e += color3f(er[k], eg[k], eb[k]);
+                else
+                    e.set(er[k], eg[k], eb[k]);
+            }
+        });
+    }
+
+    // vl of all mesh points (positions in vertex::p), one normal for the calc surface
+    static void direct_illuminance(const Luminaire *luminaires, u32 l_count, Geometry &mesh, const vec3f &normal)
+    {
+        u32 count = mesh.getPointsCount();
+        std::vector<float> soa(size_t(count) * 6);
+        float *px = soa.data(), *py = px + count, *pz = py + count;
+        float *nx = pz + count, *ny = nx + count, *nz = ny + count;
+        std::vector<color3f> E(count);
+
+        for (u32 i = 0; i < count; ++i)
+        {
+            const vec3f &p = mesh[i]->p;
+            px[i] = p.x;
+            py[i] = p.y;
+            pz[i] = p.z;
+            nx[i] = normal.x;
+            ny[i] = normal.y;
+            nz[i] = normal.z;
+        }
+
+        direct_illuminance(luminaires, l_count, px, py, pz, nx, ny, nz, count, E.data());
+
+        for (u32 i = 0; i < count; ++i)
+            mesh[i]->vl = E[i];
+    }
+}
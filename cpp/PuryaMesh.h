@@ -3,15 +3,22 @@
 class Geometry
 {
 
-    Material m_material;
-    vertex **points = nullptr;
+    MaterialHandle m_material;
+    std::pmr::memory_resource *m_resource;
+    vertex *points = nullptr;
     u32 p_count = 0;
+    u32 *indices = nullptr; // calc surface triangles (3 point indices per triangle)
+    u32 t_count = 0;
 
 public:
-    Geometry()
+    explicit Geometry(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+        : m_resource(resource)
     {
     }
 
+    Geometry(const Geometry &) = delete;
+    Geometry &operator=(const Geometry &) = delete;
+
     ~Geometry()
     {
         clear();
@@ -19,37 +26,108 @@ public:
 
     void clear()
     {
-        for (u32 i = 0; i < p_count; i++)
+        clearTriangles();
+        if (points)
         {
-            delete points[i];
+            for (u32 i = 0; i < p_count; i++)
+            {
+                points[i].~vertex();
+            }
+            m_resource->deallocate(points, sizeof(vertex) * p_count, alignof(vertex));
         }
+        points = nullptr;
+        p_count = 0;
+    }
+
+    // legacy path: wraps a private copy of mat
+    void setMaterial(const Material &mat)
+    {
+        m_material = MaterialHandle(mat);
     }
 
-    void setMaterial(Material &mat)
+    // shared material, edits through any copy of the handle are visible here
+    void setMaterial(const MaterialHandle &mat)
     {
         m_material = mat;
     }
 
+    // all points in one contiguous block (one allocator call per mesh)
     void setPoints(const vertex &point, u32 count)
     {
+        clear();
+
+        if (!count)
+            return;
 
+        points = static_cast<vertex *>(m_resource->allocate(sizeof(vertex) * count, alignof(vertex)));
         p_count = count;
-        points = new vertex *[p_count];
         for (u32 i = 0; i < p_count; i++)
         {
-            points[i] = new vertex(point);
+            new (points + i) vertex(point);
+        }
+    }
+
+    void clearTriangles()
+    {
+        if (indices)
+        {
+            m_resource->deallocate(indices, sizeof(u32) * 3 * t_count, alignof(u32));
         }
+        indices = nullptr;
+        t_count = 0;
+    }
+
+    // idx - 3 * count point indices
+    void setTriangles(const u32 *idx, u32 count)
+    {
+        clearTriangles();
+
+        if (!count)
+            return;
+
+        indices = static_cast<u32 *>(m_resource->allocate(sizeof(u32) * 3 * count, alignof(u32)));
+        t_count = count;
+        for (u32 i = 0; i < 3 * t_count; i++)
+        {
+            assert(idx[i] < p_count);
+            indices[i] = idx[i];
+        }
+    }
+
+    const u32 *getTriangles() const
+    {
+        return indices;
+    }
+
+    u32 getTrianglesCount() const
+    {
+        return t_count;
+    }
+
+    const Material &getMaterial() const
+    {
+        return m_material.get();
     }
 
-    Material &getMaterial()
+    const MaterialHandle &getMaterialHandle() const
     {
         return m_material;
     }
 
-    vertex *&operator[](u32 index) const
+    std::pmr::memory_resource *getResource() const
+    {
+        return m_resource;
+    }
+
+    u32 getPointsCount() const
+    {
+        return p_count;
+    }
+
+    vertex *operator[](u32 index) const
     {
 
-        return points[index];
+        return points + index;
     };
 
     void show()
@@ -59,7 +137,7 @@ public:
         {
             cout << i;
             cout << "\n";
-            points[i]->show();
+            points[i].show();
         }
         cout << "\n";
     }
@@ -81,25 +159,38 @@ namespace
 class PuryaMesh
 {
 
-    u32 m_calc_points_count;
+    u32 m_calc_points_count = 0;
     Geometry *m_calc_mesh;
 
 public:
-    PuryaMesh()
+    // resource - allocator for geometry and points (e.g. memory_utils::SceneArena::resource())
+    explicit PuryaMesh(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
     {
-        m_calc_mesh = new Geometry();
+        std::pmr::polymorphic_allocator<Geometry> alloc(resource);
+        m_calc_mesh = alloc.allocate(1);
+        new (m_calc_mesh) Geometry(resource);
     };
     ~PuryaMesh()
     {
-        delete m_calc_mesh;
+        std::pmr::polymorphic_allocator<Geometry> alloc(m_calc_mesh->getResource());
+        m_calc_mesh->~Geometry();
+        alloc.deallocate(m_calc_mesh, 1);
     };
 
+    PuryaMesh(const PuryaMesh &) = delete;
+    PuryaMesh &operator=(const PuryaMesh &) = delete;
+
     Geometry *&getGeometry()
     {
         return m_calc_mesh;
     }
 
-    void setMaterial(Material &mat)
+    void setMaterial(const Material &mat)
+    {
+        m_calc_mesh->setMaterial(mat);
+    }
+
+    void setMaterial(const MaterialHandle &mat)
     {
         m_calc_mesh->setMaterial(mat);
     }
@@ -115,6 +206,46 @@ public:
         m_calc_mesh->show();
     }
 
+    // vs - summary illuminance [0,Inf] [lx], cd - diffuse spectrum of material
+    // c - luminance color (sRGB), cg - illuminance color (sRGB, gray)
+    static void colorPoint(color3f vs, color3f cd, color4f &c, color4f &cg)
+    {
+        // vs.set(0.7f, 0.4f, 0.7f);
+        // ������ ��� �������� ������ (������������)
+        cg.set(vs.sum() / 3.0f);     // ��������� � ������������
+        color_normalize(cg, IL_MAX); // ���������
+        convert(cg, IL_POW);         // ��������� pow ��������
+        cg = from_linear(cg);        // ����������� � sRGB ����
+
+        // ������ ��� �������� �����������
+        c = illum_to_lum(vs, cd);  // ��������� � �������
+        colorLuminance(c);
+    }
+
+    // c - luminance [0,Inf] [cd/m^2] -> luminance color (sRGB)
+    static void colorLuminance(color4f &c)
+    {
+        color_normalize(c, L_MAX); // ���������
+        convert(c);                // ��������� ��������������� ��������
+        c = from_linear(c);        // ����������� � sRGB ����
+    }
+
+    u32 getPointsCount() const
+    {
+        return m_calc_points_count;
+    }
+
+    // colors points [begin, end) (scene scheduler tasks), cd - diffuse spectrum of the mesh material
+    void normalizeColor(const color3f &cd, u32 begin, u32 end)
+    {
+        assert(end <= m_calc_points_count);
+        for (u32 i = begin; i < end; ++i)
+        {
+            vertex *v = (*m_calc_mesh)[i];
+            colorPoint(v->vl + v->vd, cd, v->c, v->cg);
+        }
+    }
+
     bool normalizeColor()
     {
         if (m_calc_points_count)
@@ -133,18 +264,7 @@ public:
                 color4f &cg = v->cg; // sRGB ��� �������� ������ [0,1]
                 vs = v->vl + v->vd;  // ��������� ������������ [0,Inf] [��]
 
-                // vs.set(0.7f, 0.4f, 0.7f);
-                // ������ ��� �������� ������ (������������)
-                cg.set(vs.sum() / 3.0f);     // ��������� � ������������
-                color_normalize(cg, IL_MAX); // ���������
-                convert(cg, IL_POW);         // ��������� pow ��������
-                cg = from_linear(cg);        // ����������� � sRGB ����
-
-                // ������ ��� �������� �����������
-                c = illum_to_lum(vs, cd);  // ��������� � �������
-                color_normalize(c, L_MAX); // ���������
-                convert(c);                // ��������� ��������������� ��������
-                c = from_linear(c);        // ����������� � sRGB ����
+                colorPoint(vs, cd, c, cg);
             }
             return true;
         }
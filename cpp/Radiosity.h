@@ -0,0 +1,204 @@
+#pragma once
+
+#include <vector>
+
+struct patch
+{
+    vec3f p;          ///< centroid
+    vec3f n;          ///< normal
+    float area = 0.0f;
+    u32 material = 0; ///< index in Radiosity materials
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Radiosity
+// Patch based interreflection (diffuse component vd) from the direct component vl:
+//   vd_i = sum_j F_ij * rho_j * (vl_j + vd_j)
+// rho_j - Material::getDiffuseSpectrum of the patch material, F_ij - sparse form factors (CSR).
+// Parallel Jacobi iterations until the residual drops below the tolerance; a material
+// change re-solves starting from the previous vd.
+class Radiosity
+{
+    std::vector<patch> m_patches;
+    std::vector<color3f> m_rho; // diffuse spectrum per material
+
+    std::vector<u32> m_row;     // CSR: form factors of patch i are m_ff[m_row[i] .. m_row[i + 1])
+    std::vector<u32> m_col;
+    std::vector<float> m_ff;
+
+    std::vector<color3f> m_vl;
+    std::vector<color3f> m_vd;
+
+    u32 m_iterations = 0;
+    float m_residual = 0.0f;
+
+public:
+    u32 addMaterial(const Material &mtl)
+    {
+        m_rho.push_back(mtl.getDiffuseSpectrum());
+        return u32(m_rho.size() - 1);
+    }
+
+    // what-if: new wall color etc., call solve() again
+    void updateMaterial(u32 index, const Material &mtl)
+    {
+        assert(index < m_rho.size());
+        m_rho[index] = mtl.getDiffuseSpectrum();
+    }
+
+    void setPatches(const std::vector<patch> &patches)
+    {
+        m_patches = patches;
+        m_vl.assign(m_patches.size(), color3f());
+        m_vd.assign(m_patches.size(), color3f());
+        m_row.assign(m_patches.size() + 1, 0);
+        m_col.clear();
+        m_ff.clear();
+    }
+
+    u32 getPatchesCount() const { return u32(m_patches.size()); }
+
+    void setDirect(u32 i, const color3f &vl) { m_vl[i] = vl; }
+    const color3f &getDirect(u32 i) const { return m_vl[i]; }
+    const color3f &getDiffuse(u32 i) const { return m_vd[i]; }
+
+    u32 getIterations() const { return m_iterations; }
+    float getResidual() const { return m_residual; }
+    size_t getFormFactorsCount() const { return m_ff.size(); }
+
+    // precomputed sparse form factors, row i - patches seen from i
+    void setFormFactors(const std::vector<u32> &row, const std::vector<u32> &col, const std::vector<float> &ff)
+    {
+        assert(row.size() == m_patches.size() + 1 && col.size() == ff.size());
+        m_row = row;
+        m_col = col;
+        m_ff = ff;
+    }
+
+    // unoccluded point-to-disc approximation, factors below min_ff are dropped
+    //   F_ij = cos_i * cos_j * A_j / (PI * r^2 + A_j)
+    void computeFormFactors(float min_ff = 1e-5f)
+    {
+        u32 count = getPatchesCount();
+        std::vector<std::vector<u32>> cols(count);
+        std::vector<std::vector<float>> ffs(count);
+
+        parallel_utils::parallel_for(0, count, 64, [&](u32 begin, u32 end)
+        {
+            for (u32 i = begin; i < end; ++i)
+            {
+                const patch &pi = m_patches[i];
+                for (u32 j = 0; j < count; ++j)
+                {
+                    if (i == j)
+                        continue;
+
+                    const patch &pj = m_patches[j];
+                    vec3f d = pj.p - pi.p;
+                    float r2 = d.dot(d);
+                    if (r2 <= 0.0f)
+                        continue;
+
+                    vec3f dir = d / std::sqrt(r2);
+                    float cos_i = pi.n.dot(dir);
+                    float cos_j = -pj.n.dot(dir);
+                    if (cos_i <= 0.0f || cos_j <= 0.0f)
+                        continue;
+
+                    float f = cos_i * cos_j * pj.area / (mesh_utils::PI * r2 + pj.area);
+                    if (f >= min_ff)
+                    {
+                        cols[i].push_back(j);
+                        ffs[i].push_back(f);
+                    }
+                }
+            }
+        });
+
+        m_row.assign(count + 1, 0);
+        for (u32 i = 0; i < count; ++i)
+            m_row[i + 1] = m_row[i] + u32(cols[i].size());
+
+        m_col.resize(m_row[count]);
+        m_ff.resize(m_row[count]);
+        for (u32 i = 0; i < count; ++i)
+        {
+            std::copy(cols[i].begin(), cols[i].end(), m_col.begin() + m_row[i]);
+            std::copy(ffs[i].begin(), ffs[i].end(), m_ff.begin() + m_row[i]);
+        }
+    }
+
+    // tolerance - max change of vd relative to the max direct illuminance,
+    // false if a patch refers to a material that was not added
+    bool solve(float tolerance = 1e-3f, u32 max_iterations = 100)
+    {
+        u32 count = getPatchesCount();
+        if (!count)
+            return false;
+
+        for (const patch &p : m_patches)
+        {
+            if (p.material >= m_rho.size())
+                return false;
+        }
+
+        float scale = 0.0f;
+        for (color3f vl : m_vl)
+            scale = std::max(scale, vl.max());
+        if (scale <= 0.0f)
+        {
+            m_vd.assign(count, color3f());
+            m_iterations = 0;
+            m_residual = 0.0f;
+            return true;
+        }
+
+        std::vector<color3f> exitance(count);
+        std::vector<color3f> next(count);
+        std::vector<float> residual(count);
+
+        for (m_iterations = 0; m_iterations < max_iterations;)
+        {
+            // M_j = rho_j * (vl_j + vd_j)
+            for (u32 j = 0; j < count; ++j)
+                exitance[j] = (m_vl[j] + m_vd[j]) * m_rho[m_patches[j].material];
+
+            parallel_utils::parallel_for(0, count, 256, [&](u32 begin, u32 end)
+            {
+                for (u32 i = begin; i < end; ++i)
+                {
+                    color3f e;
+                    for (u32 k = m_row[i]; k < m_row[i + 1]; ++k)
+                        e += exitance[m_col[k]] * m_ff[k];
+
+                    color3f d = e - m_vd[i];
+                    residual[i] = std::max(std::abs(d.r), std::max(std::abs(d.g), std::abs(d.b)));
+                    next[i] = e;
+                }
+            });
+
+            m_vd.swap(next);
+            ++m_iterations;
+
+            m_residual = *std::max_element(residual.begin(), residual.end()) / scale;
+            if (m_residual < tolerance)
+                return true;
+        }
+        return false;
+    }
+
+    // patches are the calc points of mesh (same order)
+    bool apply(Geometry &mesh) const
+    {
+        if (mesh.getPointsCount() != getPatchesCount())
+            return false;
+
+        for (u32 i = 0; i < getPatchesCount(); ++i)
+        {
+            vertex *v = mesh[i];
+            v->vd = m_vd[i];
+            v->vs = v->vl + v->vd;
+        }
+        return true;
+    }
+};
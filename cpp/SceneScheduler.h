@@ -0,0 +1,235 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// SceneScheduler
+// Colors a whole scene of PuryaMesh objects on all cores.
+// Meshes are cut into tasks of about grain points: small meshes are batched into one task, large meshes
+// are split. Every worker starts with a contiguous run of tasks holding an equal share of the points,
+// takes tasks from the front of its run and, when it is empty, steals from the back of the others.
+// Material preparation runs once per distinct material before coloring, from the mesh material handles
+// or from one MaterialStore snapshot.
+class SceneScheduler
+{
+    // points [begin, end) of one mesh
+    struct piece
+    {
+        u32 mesh;
+        u32 material; // index in m_cd
+        u32 begin;
+        u32 end;
+    };
+
+    // task queue of one worker: [begin, end) task indices packed into one word,
+    // the owner pops begin, thieves pop end, both with one CAS
+    struct alignas(64) run
+    {
+        std::atomic<u64> range{0};
+    };
+
+    std::vector<piece> m_pieces;
+    std::vector<u32> m_tasks; // task i = m_pieces[m_tasks[i], m_tasks[i + 1])
+    std::vector<color3f> m_cd; // prepared diffuse spectrum per distinct material
+    std::vector<u32> m_material; // per mesh, index in m_cd
+    std::atomic<u32> m_steals{0};
+
+    static u64 pack(u32 begin, u32 end) { return u64(begin) << 32 | end; }
+
+    static bool popFront(run &r, u32 &task)
+    {
+        u64 range = r.range.load();
+        while (u32(range >> 32) < u32(range))
+        {
+            if (r.range.compare_exchange_weak(range, range + (u64(1) << 32)))
+            {
+                task = u32(range >> 32);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static bool popBack(run &r, u32 &task)
+    {
+        u64 range = r.range.load();
+        while (u32(range >> 32) < u32(range))
+        {
+            if (r.range.compare_exchange_weak(range, range - 1))
+            {
+                task = u32(range) - 1;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void prepareMaterials(PuryaMesh *const *meshes, u32 count)
+    {
+        std::unordered_map<const Material *, u32> index;
+        std::vector<const Material *> distinct;
+        m_material.resize(count);
+        for (u32 m = 0; m < count; ++m)
+        {
+            const Material *mtl = &meshes[m]->getGeometry()->getMaterial();
+            auto it = index.emplace(mtl, u32(distinct.size())).first;
+            if (it->second == distinct.size())
+                distinct.push_back(mtl);
+            m_material[m] = it->second;
+        }
+
+        m_cd.resize(distinct.size());
+        parallel_utils::parallel_for(0, u32(distinct.size()), 256, [&](u32 begin, u32 end)
+        {
+            for (u32 i = begin; i < end; ++i)
+                m_cd[i] = distinct[i]->getDiffuseSpectrumColor();
+        });
+    }
+
+    // materials - MaterialStore id per mesh, all read from one snapshot of the store
+    void prepareMaterials(const MaterialStore &store, const u32 *materials, u32 count)
+    {
+        std::unordered_map<u32, u32> index;
+        std::vector<u32> distinct;
+        m_material.resize(count);
+        for (u32 m = 0; m < count; ++m)
+        {
+            auto it = index.emplace(materials[m], u32(distinct.size())).first;
+            if (it->second == distinct.size())
+                distinct.push_back(materials[m]);
+            m_material[m] = it->second;
+        }
+
+        MaterialStore::reader reader(store);
+        m_cd.resize(distinct.size());
+        parallel_utils::parallel_for(0, u32(distinct.size()), 256, [&](u32 begin, u32 end)
+        {
+            for (u32 i = begin; i < end; ++i)
+                m_cd[i] = reader.get(distinct[i]).getDiffuseSpectrumColor();
+        });
+    }
+
+    void buildTasks(PuryaMesh *const *meshes, u32 count)
+    {
+        m_pieces.clear();
+        m_tasks.clear();
+
+        u32 points = 0; // in the current task
+        for (u32 m = 0; m < count; ++m)
+        {
+            u32 size = meshes[m]->getPointsCount();
+            for (u32 begin = 0; begin < size;)
+            {
+                if (!points)
+                    m_tasks.push_back(u32(m_pieces.size()));
+
+                u32 end = begin + std::min(size - begin, grain - points);
+                m_pieces.push_back({m, m_material[m], begin, end});
+                points = (points + end - begin) % grain;
+                begin = end;
+            }
+        }
+        m_tasks.push_back(u32(m_pieces.size()));
+    }
+
+    void runTask(PuryaMesh *const *meshes, u32 task) const
+    {
+        for (u32 i = m_tasks[task]; i < m_tasks[task + 1]; ++i)
+        {
+            const piece &p = m_pieces[i];
+            meshes[p.mesh]->normalizeColor(m_cd[p.material], p.begin, p.end);
+        }
+    }
+
+    // colors meshes with the prepared materials
+    void schedule(PuryaMesh *const *meshes, u32 count, u32 threads)
+    {
+        assert(grain);
+        buildTasks(meshes, count);
+        m_steals = 0;
+
+        u32 tasks = u32(m_tasks.size()) - 1;
+        threads = std::min(threads ? threads : parallel_utils::thread_count(), tasks);
+        if (threads <= 1)
+        {
+            for (u32 t = 0; t < tasks; ++t)
+                runTask(meshes, t);
+            return;
+        }
+
+        // every task holds grain points except the last, equal task runs are equal point shares
+        std::vector<run> runs(threads);
+        for (u32 w = 0; w < threads; ++w)
+            runs[w].range.store(pack(u32(u64(tasks) * w / threads), u32(u64(tasks) * (w + 1) / threads)));
+
+        auto worker = [&](u32 w)
+        {
+            u32 task;
+            while (popFront(runs[w], task))
+                runTask(meshes, task);
+
+            // steal from the victim with the most work left
+            for (;;)
+            {
+                u32 victim = w;
+                u32 left = 0;
+                for (u32 v = 0; v < threads; ++v)
+                {
+                    u64 range = runs[v].range.load(std::memory_order_relaxed);
+                    u32 n = u32(range) > u32(range >> 32) ? u32(range) - u32(range >> 32) : 0;
+                    if (n > left)
+                    {
+                        left = n;
+                        victim = v;
+                    }
+                }
+                if (!left)
+                    return;
+                if (popBack(runs[victim], task))
+                {
+                    ++m_steals;
+                    runTask(meshes, task);
+                }
+            }
+        };
+
+        std::vector<std::thread> pool;
+        pool.reserve(threads - 1);
+        for (u32 w = 1; w < threads; ++w)
+            pool.emplace_back(worker, w);
+        worker(0);
+        for (std::thread &t : pool)
+            t.join();
+    }
+
+public:
+    // points per task, small enough to balance, large enough to hide the scheduling
+    u32 grain = 4096;
+
+    // colors all meshes, threads = 0 - all cores
+    void normalizeColor(PuryaMesh *const *meshes, u32 count, u32 threads = 0)
+    {
+        prepareMaterials(meshes, count);
+        schedule(meshes, count, threads);
+    }
+
+    // colors all meshes with materials of a store (edited by another thread meanwhile),
+    // materials - MaterialStore id per mesh, the material handles of the meshes are not read
+    void normalizeColor(PuryaMesh *const *meshes, const u32 *materials, u32 count, const MaterialStore &store, u32 threads = 0)
+    {
+        prepareMaterials(store, materials, count);
+        schedule(meshes, count, threads);
+    }
+
+    void normalizeColor(std::vector<PuryaMesh *> &meshes, u32 threads = 0)
+    {
+        normalizeColor(meshes.data(), u32(meshes.size()), threads);
+    }
+
+    u32 getTasksCount() const { return m_tasks.empty() ? 0 : u32(m_tasks.size()) - 1; }
+    u32 getMaterialsCount() const { return u32(m_cd.size()); }
+    u32 getStealsCount() const { return m_steals; }
+};
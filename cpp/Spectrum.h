@@ -0,0 +1,293 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+// number of spectral bands over 380..730 nm (compile time), multiple of 8 keeps rows SIMD aligned
+#ifndef SPECTRAL_BANDS
+#define SPECTRAL_BANDS 16
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// spectrum
+// Fixed width N band spectrum. spectrum_t<3> is color3f itself, so RGB code pays nothing.
+template <u32 N>
+struct alignas(32) spectrum
+{
+    float v[N];
+
+    spectrum() { set(0.0f); }
+    explicit spectrum(float value) { set(value); }
+
+    void set(float value)
+    {
+        for (u32 i = 0; i < N; ++i)
+            v[i] = value;
+    }
+
+    float &operator[](u32 i) { return v[i]; }
+    const float &operator[](u32 i) const { return v[i]; }
+
+    spectrum operator+(const spectrum &s) const
+    {
+        spectrum r;
+        for (u32 i = 0; i < N; ++i)
+            r.v[i] = v[i] + s.v[i];
+        return r;
+    }
+
+    spectrum operator*(const spectrum &s) const
+    {
+        spectrum r;
+        for (u32 i = 0; i < N; ++i)
+            r.v[i] = v[i] * s.v[i];
+        return r;
+    }
+
+    spectrum operator*(float scalar) const
+    {
+        spectrum r;
+        for (u32 i = 0; i < N; ++i)
+            r.v[i] = v[i] * scalar;
+        return r;
+    }
+
+    spectrum &operator+=(const spectrum &s)
+    {
+        for (u32 i = 0; i < N; ++i)
+            v[i] += s.v[i];
+        return (*this);
+    }
+
+    spectrum &operator*=(const spectrum &s)
+    {
+        for (u32 i = 0; i < N; ++i)
+            v[i] *= s.v[i];
+        return (*this);
+    }
+
+    spectrum &operator*=(float scalar)
+    {
+        for (u32 i = 0; i < N; ++i)
+            v[i] *= scalar;
+        return (*this);
+    }
+
+    float max() const
+    {
+        float m = v[0];
+        for (u32 i = 1; i < N; ++i)
+            m = (v[i] > m) ? v[i] : m;
+        return m;
+    }
+};
+
+template <u32 N>
+struct spectrum_type
+{
+    typedef spectrum<N> type;
+};
+
+template <>
+struct spectrum_type<3>
+{
+    typedef color3f type;
+};
+
+template <u32 N>
+using spectrum_t = typename spectrum_type<N>::type;
+
+typedef spectrum_t<SPECTRAL_BANDS> spectrumf;
+
+namespace spectral_utils
+{
+    static const float lambda_min = 380.0f; // [nm]
+    static const float lambda_max = 730.0f; // [nm]
+
+    // CIE 1931 2 deg color matching functions, multi-lobe gaussian fit (Wyman, Sloan, Shirley 2013)
+    static float cie_x(float l)
+    {
+        float t1 = (l - 442.0f) * ((l < 442.0f) ? 0.0624f : 0.0374f);
+        float t2 = (l - 599.8f) * ((l < 599.8f) ? 0.0264f : 0.0323f);
+        float t3 = (l - 501.1f) * ((l < 501.1f) ? 0.0490f : 0.0382f);
+        return 0.362f * exp(-0.5f * t1 * t1) + 1.056f * exp(-0.5f * t2 * t2) - 0.065f * exp(-0.5f * t3 * t3);
+    }
+
+    static float cie_y(float l)
+    {
+        float t1 = (l - 568.8f) * ((l < 568.8f) ? 0.0213f : 0.0247f);
+        float t2 = (l - 530.9f) * ((l < 530.9f) ? 0.0613f : 0.0322f);
+        return 0.821f * exp(-0.5f * t1 * t1) + 0.286f * exp(-0.5f * t2 * t2);
+    }
+
+    static float cie_z(float l)
+    {
+        float t1 = (l - 437.0f) * ((l < 437.0f) ? 0.0845f : 0.0278f);
+        float t2 = (l - 459.0f) * ((l < 459.0f) ? 0.0385f : 0.0725f);
+        return 1.217f * exp(-0.5f * t1 * t1) + 0.681f * exp(-0.5f * t2 * t2);
+    }
+
+    // band -> linear sRGB weights, flat spectrum 1 projects to (1, 1, 1)
+    // inv_* - minimum norm inverse (M^T (M M^T)^-1) used by from_rgb
+    template <u32 N>
+    struct projection
+    {
+        float r[N], g[N], b[N], y[N];
+        float inv_r[N], inv_g[N], inv_b[N];
+
+        projection()
+        {
+            const u32 sub = 8; // samples per band
+            float X[N], Y[N], Z[N];
+            float sy = 0.0f;
+            float width = (lambda_max - lambda_min) / N;
+
+            for (u32 i = 0; i < N; ++i)
+            {
+                X[i] = Y[i] = Z[i] = 0.0f;
+                for (u32 s = 0; s < sub; ++s)
+                {
+                    float l = lambda_min + width * (i + (s + 0.5f) / sub);
+                    X[i] += cie_x(l);
+                    Y[i] += cie_y(l);
+                    Z[i] += cie_z(l);
+                }
+                sy += Y[i];
+            }
+
+            // XYZ -> linear sRGB (D65), then white balance so that a flat spectrum is white
+            float rs = 0.0f, gs = 0.0f, bs = 0.0f;
+            for (u32 i = 0; i < N; ++i)
+            {
+                float x = X[i] / sy, yv = Y[i] / sy, z = Z[i] / sy;
+                r[i] = 3.2406f * x - 1.5372f * yv - 0.4986f * z;
+                g[i] = -0.9689f * x + 1.8758f * yv + 0.0415f * z;
+                b[i] = 0.0557f * x - 0.2040f * yv + 1.0570f * z;
+                y[i] = yv;
+                rs += r[i];
+                gs += g[i];
+                bs += b[i];
+            }
+            for (u32 i = 0; i < N; ++i)
+            {
+                r[i] /= rs;
+                g[i] /= gs;
+                b[i] /= bs;
+            }
+
+            // inverse: B = M^T (M M^T)^-1
+            float m[3][3] = {{0}};
+            const float *rows[3] = {r, g, b};
+            for (u32 a = 0; a < 3; ++a)
+                for (u32 c = 0; c < 3; ++c)
+                    for (u32 i = 0; i < N; ++i)
+                        m[a][c] += rows[a][i] * rows[c][i];
+
+            float det = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+            float inv[3][3];
+            inv[0][0] = (m[1][1] * m[2][2] - m[1][2] * m[2][1]) / det;
+            inv[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) / det;
+            inv[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) / det;
+            inv[1][0] = (m[1][2] * m[2][0] - m[1][0] * m[2][2]) / det;
+            inv[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) / det;
+            inv[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) / det;
+            inv[2][0] = (m[1][0] * m[2][1] - m[1][1] * m[2][0]) / det;
+            inv[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) / det;
+            inv[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) / det;
+
+            for (u32 i = 0; i < N; ++i)
+            {
+                inv_r[i] = r[i] * inv[0][0] + g[i] * inv[1][0] + b[i] * inv[2][0];
+                inv_g[i] = r[i] * inv[0][1] + g[i] * inv[1][1] + b[i] * inv[2][1];
+                inv_b[i] = r[i] * inv[0][2] + g[i] * inv[1][2] + b[i] * inv[2][2];
+            }
+        }
+
+        static const projection &get()
+        {
+            static const projection p;
+            return p;
+        }
+    };
+
+    // spectrum -> linear RGB
+    template <u32 N>
+    static color3f to_rgb(const spectrum<N> &s)
+    {
+        const projection<N> &p = projection<N>::get();
+        float r = 0.0f, g = 0.0f, b = 0.0f;
+        for (u32 i = 0; i < N; ++i)
+        {
+            r += p.r[i] * s.v[i];
+            g += p.g[i] * s.v[i];
+            b += p.b[i] * s.v[i];
+        }
+        return color3f(r, g, b);
+    }
+
+    static color3f to_rgb(const color3f &s) { return s; }
+
+    // spectrum -> relative luminance Y
+    template <u32 N>
+    static float to_Y(const spectrum<N> &s)
+    {
+        const projection<N> &p = projection<N>::get();
+        float y = 0.0f;
+        for (u32 i = 0; i < N; ++i)
+            y += p.y[i] * s.v[i];
+        return y;
+    }
+
+    static float to_Y(const color3f &s)
+    {
+        return material_utils::K_R * s.r + material_utils::K_G * s.g + material_utils::K_B * s.b;
+    }
+
+    // linear RGB -> spectrum: gray part is flat, the chromatic rest is the minimum norm spectrum
+    // (may leave [0, 1] for saturated colors), to_rgb(from_rgb(c)) == c
+    template <u32 N>
+    static void from_rgb(const color3f &c, spectrum<N> &s)
+    {
+        const projection<N> &p = projection<N>::get();
+        float m = std::min(c.r, std::min(c.g, c.b));
+        float r = c.r - m, g = c.g - m, b = c.b - m;
+        for (u32 i = 0; i < N; ++i)
+            s.v[i] = m + p.inv_r[i] * r + p.inv_g[i] * g + p.inv_b[i] * b;
+    }
+
+    static void from_rgb(const color3f &c, color3f &s) { s = c; }
+
+    // batch projection, out_y may be nullptr
+    template <u32 N>
+    static void project(const spectrum<N> *in, u32 count, color3f *out_rgb, float *out_y = nullptr)
+    {
+        const projection<N> &p = projection<N>::get();
+        for (u32 k = 0; k < count; ++k)
+        {
+            const float *v = in[k].v;
+            float r = 0.0f, g = 0.0f, b = 0.0f, y = 0.0f;
+            for (u32 i = 0; i < N; ++i)
+            {
+                r += p.r[i] * v[i];
+                g += p.g[i] * v[i];
+                b += p.b[i] * v[i];
+                y += p.y[i] * v[i];
+            }
+            if (out_rgb)
+                out_rgb[k].set(r, g, b);
+            if (out_y)
+                out_y[k] = y;
+        }
+    }
+
+    static void project(const color3f *in, u32 count, color3f *out_rgb, float *out_y = nullptr)
+    {
+        for (u32 k = 0; k < count; ++k)
+        {
+            if (out_rgb)
+                out_rgb[k] = in[k];
+            if (out_y)
+                out_y[k] = to_Y(in[k]);
+        }
+    }
+}
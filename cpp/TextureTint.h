@@ -0,0 +1,216 @@
+#pragma once
+
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TEXTURE_SSE2
+#endif
+
+// 8 bit sRGB texture, RGBA interleaved, rows top-down
+struct texture_rgba8
+{
+    u32 width = 0;
+    u32 height = 0;
+    std::vector<u8> data;
+
+    void create(u32 w, u32 h)
+    {
+        width = w;
+        height = h;
+        data.assign(size_t(w) * h * 4, 0);
+    }
+
+    u8 *row(u32 y) { return data.data() + size_t(y) * width * 4; }
+    const u8 *row(u32 y) const { return data.data() + size_t(y) * width * 4; }
+};
+
+// Diffuse texture tinting: the whole texture is rescaled in linear space so that its mean
+// luminance is the material diffuse reflectance, texels leaving [0, 1] are desaturated towards
+// white keeping their luminance (material_utils::changeY per texel), only texels already
+// clipped to white lose luminance.
+// sRGB <-> linear goes through lookup tables, rows are processed in parallel bands, the
+// saturation runs on 4 texels at a time with SSE2 (as the JsonLoader index does).
+namespace texture_utils
+{
+    static const u32 encode_bits = 13;
+    static const u32 encode_size = 1 << encode_bits;
+
+    struct lut
+    {
+        float decode[256];       // sRGB byte -> linear
+        u8 encode[encode_size + 1]; // linear [0, 1] -> sRGB byte
+
+        lut()
+        {
+            for (u32 i = 0; i < 256; ++i)
+                decode[i] = material_utils::to_linear(i / 255.0f);
+            for (u32 i = 0; i <= encode_size; ++i)
+                encode[i] = u8(material_utils::from_linear(float(i) / encode_size) * 255.0f + 0.5f);
+        }
+
+        static const lut &get()
+        {
+            static const lut l;
+            return l;
+        }
+    };
+
+    static u8 encode(const lut &l, float linear)
+    {
+        linear = (linear < 0.0f) ? 0.0f : (linear > 1.0f) ? 1.0f : linear;
+        return l.encode[u32(linear * encode_size + 0.5f)];
+    }
+
+    static const u32 band_rows = 16;
+
+    // mean relative luminance Y of the texture
+    static float meanLuminance(const texture_rgba8 &tex)
+    {
+        if (tex.data.empty())
+            return 0.0f;
+
+        const lut &l = lut::get();
+        std::vector<double> rows(tex.height);
+
+        parallel_utils::parallel_for(0, tex.height, band_rows, [&](u32 begin, u32 end)
+        {
+            for (u32 y = begin; y < end; ++y)
+            {
+                const u8 *p = tex.row(y);
+                float sum = 0.0f;
+                for (u32 x = 0; x < tex.width; ++x, p += 4)
+                    sum += material_utils::K_R * l.decode[p[0]] + material_utils::K_G * l.decode[p[1]] + material_utils::K_B * l.decode[p[2]];
+                rows[y] = sum;
+            }
+        });
+
+        double total = 0.0;
+        for (double r : rows)
+            total += r;
+        return float(total / (double(tex.width) * tex.height));
+    }
+
+    // changeY saturation of linear texels: the excess luminance of channels above 1 goes to the channels below 1,
+    // up to white
+    // simd = false - scalar path only (reference for the SSE2 path)
+    static void saturate(float *lr, float *lg, float *lb, u32 count, bool simd = true)
+    {
+        const float kr = material_utils::K_R, kg = material_utils::K_G, kb = material_utils::K_B;
+        u32 x = 0;
+
+#ifdef TEXTURE_SSE2
+        const __m128 one = _mm_set1_ps(1.0f), zero = _mm_setzero_ps();
+        const __m128 vkr = _mm_set1_ps(kr), vkg = _mm_set1_ps(kg), vkb = _mm_set1_ps(kb);
+        for (; simd && x + 4 <= count; x += 4)
+        {
+            __m128 r = _mm_loadu_ps(lr + x), g = _mm_loadu_ps(lg + x), b = _mm_loadu_ps(lb + x);
+            __m128 excess = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vkr, _mm_max_ps(_mm_sub_ps(r, one), zero)), _mm_mul_ps(vkg, _mm_max_ps(_mm_sub_ps(g, one), zero))),
+                                       _mm_mul_ps(vkb, _mm_max_ps(_mm_sub_ps(b, one), zero)));
+            r = _mm_min_ps(r, one);
+            g = _mm_min_ps(g, one);
+            b = _mm_min_ps(b, one);
+            __m128 room = _mm_add_ps(_mm_add_ps(_mm_mul_ps(vkr, _mm_sub_ps(one, r)), _mm_mul_ps(vkg, _mm_sub_ps(one, g))), _mm_mul_ps(vkb, _mm_sub_ps(one, b)));
+            __m128 valid = _mm_and_ps(_mm_cmpgt_ps(excess, zero), _mm_cmpgt_ps(room, zero));
+            __m128 t = _mm_and_ps(valid, _mm_min_ps(_mm_div_ps(excess, _mm_max_ps(room, _mm_set1_ps(1e-30f))), one));
+            _mm_storeu_ps(lr + x, _mm_add_ps(r, _mm_mul_ps(_mm_sub_ps(one, r), t)));
+            _mm_storeu_ps(lg + x, _mm_add_ps(g, _mm_mul_ps(_mm_sub_ps(one, g), t)));
+            _mm_storeu_ps(lb + x, _mm_add_ps(b, _mm_mul_ps(_mm_sub_ps(one, b), t)));
+        }
+#endif
+
+        for (; x < count; ++x)
+        {
+            float r = lr[x], g = lg[x], b = lb[x];
+            float excess = kr * std::max(r - 1.0f, 0.0f) + kg * std::max(g - 1.0f, 0.0f) + kb * std::max(b - 1.0f, 0.0f);
+            r = std::min(r, 1.0f);
+            g = std::min(g, 1.0f);
+            b = std::min(b, 1.0f);
+            float room = kr * (1.0f - r) + kg * (1.0f - g) + kb * (1.0f - b);
+            float t = (excess > 0.0f && room > 0.0f) ? std::min(excess / room, 1.0f) : 0.0f; // more excess than room: white
+            lr[x] = r + (1.0f - r) * t;
+            lg[x] = g + (1.0f - g) * t;
+            lb[x] = b + (1.0f - b) * t;
+        }
+    }
+
+    // Ynew - target mean luminance (e.g. Y of Material::getDiffuseSpectrum)
+    static void tint(texture_rgba8 &tex, float Ynew)
+    {
+        float Y = meanLuminance(tex);
+        if (Y <= 0.0f)
+            return;
+
+        const lut &l = lut::get();
+        const float scale = Ynew / Y;
+
+        parallel_utils::parallel_for(0, tex.height, band_rows, [&](u32 begin, u32 end)
+        {
+            std::vector<float> lr(tex.width), lg(tex.width), lb(tex.width);
+
+            for (u32 y = begin; y < end; ++y)
+            {
+                u8 *p = tex.row(y);
+
+                for (u32 x = 0; x < tex.width; ++x)
+                {
+                    lr[x] = l.decode[p[4 * x + 0]] * scale;
+                    lg[x] = l.decode[p[4 * x + 1]] * scale;
+                    lb[x] = l.decode[p[4 * x + 2]] * scale;
+                }
+
+                saturate(lr.data(), lg.data(), lb.data(), tex.width);
+
+                for (u32 x = 0; x < tex.width; ++x)
+                {
+                    p[4 * x + 0] = encode(l, lr[x]);
+                    p[4 * x + 1] = encode(l, lg[x]);
+                    p[4 * x + 2] = encode(l, lb[x]);
+                }
+            }
+        });
+    }
+
+    static void tint(texture_rgba8 &tex, const Material &mtl)
+    {
+        tint(tex, spectral_utils::to_Y(mtl.getDiffuseSpectrum()));
+    }
+
+    // next mip level, 2x2 box filter in linear space (alpha is linear)
+    static void downsample(const texture_rgba8 &src, texture_rgba8 &dst)
+    {
+        const lut &l = lut::get();
+        dst.create(std::max(src.width / 2, 1u), std::max(src.height / 2, 1u));
+
+        parallel_utils::parallel_for(0, dst.height, band_rows, [&](u32 begin, u32 end)
+        {
+            for (u32 y = begin; y < end; ++y)
+            {
+                const u8 *r0 = src.row(std::min(2 * y, src.height - 1));
+                const u8 *r1 = src.row(std::min(2 * y + 1, src.height - 1));
+                u8 *d = dst.row(y);
+
+                for (u32 x = 0; x < dst.width; ++x, d += 4)
+                {
+                    u32 x0 = 4 * std::min(2 * x, src.width - 1);
+                    u32 x1 = 4 * std::min(2 * x + 1, src.width - 1);
+                    for (u32 c = 0; c < 3; ++c)
+                        d[c] = encode(l, 0.25f * (l.decode[r0[x0 + c]] + l.decode[r0[x1 + c]] + l.decode[r1[x0 + c]] + l.decode[r1[x1 + c]]));
+                    d[3] = u8((r0[x0 + 3] + r0[x1 + 3] + r1[x0 + 3] + r1[x1 + 3] + 2) / 4);
+                }
+            }
+        });
+    }
+
+    // full chain down to 1x1, mips[0] - half size of base
+    static void buildMips(const texture_rgba8 &base, std::vector<texture_rgba8> &mips)
+    {
+        mips.clear();
+        for (const texture_rgba8 *src = &base; src->width > 1 || src->height > 1; src = &mips.back())
+        {
+            texture_rgba8 level;
+            downsample(*src, level);
+            mips.push_back(std::move(level)); // may reallocate, src is re-taken from back()
+        }
+    }
+}
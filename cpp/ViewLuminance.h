@@ -0,0 +1,123 @@
+#pragma once
+
+#include <vector>
+
+// calc points in SoA layout
+struct view_points
+{
+    u32 count = 0;
+    const float *px = nullptr, *py = nullptr, *pz = nullptr; ///< positions
+    const float *nx = nullptr, *ny = nullptr, *nz = nullptr; ///< normals
+    const float *lx = nullptr, *ly = nullptr, *lz = nullptr; ///< dominant direction to the light (nullptr - along the normal)
+    const color3f *vl = nullptr;                             ///< direct illuminance [lx]
+    const color3f *vd = nullptr;                             ///< diffuse illuminance [lx]
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// ViewLuminance
+// View dependent luminance for a batch of camera positions:
+//   L = cd * vs / PI + cs * vl * (n + 2) / (2 * PI) * cos^n(alpha)
+// cd / cs - diffuse / specular spectrum of the material, alpha - angle between the view
+// direction and the mirrored light direction, n = 1 + 127 * shininess (normalized Phong lobe).
+// The diffuse term is computed once per point and shared by all views.
+class ViewLuminance
+{
+    color3f m_cd;
+    color3f m_cs;
+    float m_exponent = 1.0f;
+
+public:
+    static const u32 block_size = 256;
+
+    void setMaterial(const Material &mtl)
+    {
+        m_cd = mtl.getDiffuseSpectrum();
+        m_cs = mtl.getSpecularSpectrum();
+        m_exponent = material_utils::to_phong_exponent(mtl.getShininess());
+    }
+
+    // views - camera positions
+    // lum - [view][channel][point] luminance [cd/m^2]
+    // colors - optional, same layout, sRGB luminance colors (as PuryaMesh c)
+    void compute(const view_points &pts, const vec3f *views, u32 v_count, float *lum, float *colors = nullptr) const
+    {
+        const u32 count = pts.count;
+        const float norm = (m_exponent + 2.0f) / (2.0f * mesh_utils::PI);
+        const float inv_pi = 1.0f / mesh_utils::PI;
+        bool has_spec = !color3f(m_cs).isEmpty();
+
+        parallel_utils::parallel_for(0, count, block_size, [&](u32 begin, u32 end)
+        {
+            u32 n = end - begin;
+            float ld[3][block_size]; // diffuse luminance
+            float rx[block_size], ry[block_size], rz[block_size]; // mirrored light direction
+            float sp[3][block_size]; // specular scale per channel (vl * cs * norm)
+
+            for (u32 k = 0; k < n; ++k)
+            {
+                u32 i = begin + k;
+                color3f vs = color3f(pts.vl[i]) + pts.vd[i];
+                ld[0][k] = m_cd.r * vs.r * inv_pi;
+                ld[1][k] = m_cd.g * vs.g * inv_pi;
+                ld[2][k] = m_cd.b * vs.b * inv_pi;
+
+                float nx = pts.nx[i], ny = pts.ny[i], nz = pts.nz[i];
+                float lx = pts.lx ? pts.lx[i] : nx;
+                float ly = pts.ly ? pts.ly[i] : ny;
+                float lz = pts.lz ? pts.lz[i] : nz;
+
+                // r = 2 (n.l) n - l
+                float nl = nx * lx + ny * ly + nz * lz;
+                rx[k] = 2.0f * nl * nx - lx;
+                ry[k] = 2.0f * nl * ny - ly;
+                rz[k] = 2.0f * nl * nz - lz;
+
+                float s = (nl > 0.0f) ? norm : 0.0f;
+                sp[0][k] = pts.vl[i].r * m_cs.r * s;
+                sp[1][k] = pts.vl[i].g * m_cs.g * s;
+                sp[2][k] = pts.vl[i].b * m_cs.b * s;
+            }
+
+            for (u32 v = 0; v < v_count; ++v)
+            {
+                const vec3f &eye = views[v];
+                float *out[3];
+                for (u32 ch = 0; ch < 3; ++ch)
+                    out[ch] = lum + (size_t(v) * 3 + ch) * count + begin;
+
+                for (u32 k = 0; k < n; ++k)
+                {
+                    float spec = 0.0f;
+                    if (has_spec)
+                    {
+                        u32 i = begin + k;
+                        float ex = eye.x - pts.px[i], ey = eye.y - pts.py[i], ez = eye.z - pts.pz[i];
+                        float len = std::sqrt(ex * ex + ey * ey + ez * ez);
+                        float facing = ex * pts.nx[i] + ey * pts.ny[i] + ez * pts.nz[i];
+                        float cos_a = (len > 0.0f && facing > 0.0f) ? (ex * rx[k] + ey * ry[k] + ez * rz[k]) / len : 0.0f;
+                        spec = (cos_a > 0.0f) ? std::pow(cos_a, m_exponent) : 0.0f;
+                    }
+                    out[0][k] = ld[0][k] + sp[0][k] * spec;
+                    out[1][k] = ld[1][k] + sp[1][k] * spec;
+                    out[2][k] = ld[2][k] + sp[2][k] * spec;
+                }
+
+                if (colors)
+                {
+                    float *col[3];
+                    for (u32 ch = 0; ch < 3; ++ch)
+                        col[ch] = colors + (size_t(v) * 3 + ch) * count + begin;
+
+                    for (u32 k = 0; k < n; ++k)
+                    {
+                        color4f c(out[0][k], out[1][k], out[2][k]);
+                        PuryaMesh::colorLuminance(c);
+                        col[0][k] = c.r;
+                        col[1][k] = c.g;
+                        col[2][k] = c.b;
+                    }
+                }
+            }
+        });
+    }
+};
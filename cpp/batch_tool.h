@@ -0,0 +1,459 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+// Command line batch conversion (main.cpp runs it when arguments are given):
+//   materials [-o spectra|graphics|all] [-j N] <in.csv|in.jsonl|-> <out.csv|->
+//       one material per line, CSV "type,r,g,b,refl_f,refl_c,trans[,n[,shin]]" (type - name or number)
+//       or JSON lines {"type": "painted", "color": [r, g, b], "reflection_factor": ...}
+//   colors -m type,r,g,b,refl_f,refl_c,trans[,n[,shin]] [-j N] <in.bin|-> <out.bin|->
+//       float32 records vl.rgb vd.rgb -> c.rgb cg.rgb (PuryaMesh::colorPoint)
+// Input is read in large blocks, converted by parallel workers and written in input order,
+// progress goes to stderr.
+namespace batch_tool
+{
+    static const size_t text_block = size_t(4) << 20;
+    static const u32 points_block = 1 << 16;
+
+    enum columns
+    {
+        columns_spectra = 1,
+        columns_graphics = 2,
+        columns_all = 3,
+    };
+
+    struct progress
+    {
+        typedef std::chrono::steady_clock clock;
+        clock::time_point start = clock::now();
+        clock::time_point last = start;
+        unsigned long long bytes = 0;
+        unsigned long long items = 0;
+        unsigned long long errors = 0;
+
+        void add(size_t b, u32 n, u32 e = 0)
+        {
+            bytes += b;
+            items += n;
+            errors += e;
+            if (clock::now() - last >= std::chrono::seconds(1))
+            {
+                last = clock::now();
+                report(false);
+            }
+        }
+
+        void report(bool final) const
+        {
+            double s = std::chrono::duration<double>(clock::now() - start).count();
+            s = (s > 0.0) ? s : 1e-9;
+            std::fprintf(stderr, "\r%llu items, %llu errors, %.1f MB, %.0f items/s, %.1f MB/s%s", items, errors,
+                         bytes / 1048576.0, items / s, bytes / 1048576.0 / s, final ? "\n" : "");
+            std::fflush(stderr);
+        }
+    };
+
+    static const char *type_names[] = {"undefined", "transparent", "metallic", "painted"};
+
+    static bool parseType(const char *s, const char *end, u32 &type)
+    {
+        while (s < end && (*s == ' ' || *s == '"'))
+            ++s;
+        while (end > s && (end[-1] == ' ' || end[-1] == '"'))
+            --end;
+
+        if (s < end && *s >= '0' && *s <= '9')
+        {
+            type = u32(std::strtoul(s, nullptr, 10));
+            return true;
+        }
+        for (u32 t = material_type::transparent; t <= material_type::painted; ++t)
+        {
+            if (size_t(end - s) == std::strlen(type_names[t]) && std::strncmp(s, type_names[t], end - s) == 0)
+            {
+                type = t;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static void setDefaults(material_params &p)
+    {
+        p = material_params();
+        p.refractive = 1.0f;
+    }
+
+    // type,r,g,b,refl_f,refl_c,trans[,n[,shin]]
+    static bool parseCsv(const char *s, const char *end, material_params &p)
+    {
+        setDefaults(p);
+
+        const char *comma = s;
+        while (comma < end && *comma != ',' && *comma != ';')
+            ++comma;
+        if (comma == end || !parseType(s, comma, p.type))
+            return false;
+
+        float *fields[8] = {&p.color[0], &p.color[1], &p.color[2], &p.reflection_factor, &p.reflection_coating, &p.transparency, &p.refractive, &p.shininess};
+        u32 n = 0;
+        for (s = comma + 1; s < end && n < 8; ++n)
+        {
+            char *next;
+            *fields[n] = std::strtof(s, &next);
+            if (next == s)
+                return false;
+            for (s = next; s < end && (*s == ' ' || *s == ',' || *s == ';'); ++s)
+                ;
+        }
+        return n >= 6 && material_batch::isValid(p);
+    }
+
+    // value after "key": in a flat JSON object, nullptr if missing
+    static const char *jsonValue(const char *s, const char *end, const char *key)
+    {
+        size_t len = std::strlen(key);
+        for (const char *q = s; q + len + 2 <= end; ++q)
+        {
+            if (*q == '"' && std::strncmp(q + 1, key, len) == 0 && q[len + 1] == '"')
+            {
+                for (q += len + 2; q < end && (*q == ' ' || *q == ':'); ++q)
+                    ;
+                return q;
+            }
+        }
+        return nullptr;
+    }
+
+    static bool parseJsonLine(const char *s, const char *end, material_params &p)
+    {
+        setDefaults(p);
+
+        const char *v = jsonValue(s, end, "type");
+        if (!v)
+            return false;
+        const char *e = v + 1;
+        while (e < end && *e != ',' && *e != '}')
+            ++e;
+        if (!parseType(v, e, p.type))
+            return false;
+
+        v = jsonValue(s, end, "color");
+        if (!v || *v != '[')
+            return false;
+        for (u32 i = 0; i < 3; ++i)
+        {
+            char *next;
+            p.color[i] = std::strtof(v + 1, &next);
+            if (next == v + 1)
+                return false;
+            for (v = next; v < end && *v == ' '; ++v)
+                ;
+        }
+
+        const char *keys[5] = {"reflection_factor", "reflection_coating", "transparency", "refractive", "shininess"};
+        float *fields[5] = {&p.reflection_factor, &p.reflection_coating, &p.transparency, &p.refractive, &p.shininess};
+        for (u32 i = 0; i < 5; ++i)
+        {
+            if ((v = jsonValue(s, end, keys[i])))
+                *fields[i] = std::strtof(v, nullptr);
+        }
+        return material_batch::isValid(p);
+    }
+
+    static void appendColor(std::string &out, const color3f &c)
+    {
+        char buf[64];
+        int n = std::snprintf(buf, sizeof(buf), ",%.6g,%.6g,%.6g", c.r, c.g, c.b);
+        out.append(buf, n);
+    }
+
+    static void appendHeader(std::string &out, u32 cols)
+    {
+        out += "line";
+        if (cols & columns_spectra)
+            out += ",diffuse_r,diffuse_g,diffuse_b,specular_r,specular_g,specular_b,transmission_r,transmission_g,transmission_b";
+        if (cols & columns_graphics)
+            out += ",gl_diffuse_r,gl_diffuse_g,gl_diffuse_b,gl_ambient_r,gl_ambient_g,gl_ambient_b,gl_specular_r,gl_specular_g,gl_specular_b,shininess,opacity,N";
+        out += "\n";
+    }
+
+    static void appendMaterial(std::string &out, unsigned long long line, const Material &mtl, u32 cols)
+    {
+        out += std::to_string(line);
+        if (cols & columns_spectra)
+        {
+            appendColor(out, mtl.getDiffuseSpectrum());
+            appendColor(out, mtl.getSpecularSpectrum());
+            appendColor(out, mtl.getTransmissionSpectrum());
+        }
+        if (cols & columns_graphics)
+        {
+            appendColor(out, mtl.getDiffuseColor());
+            appendColor(out, mtl.getAmbientColor());
+            appendColor(out, mtl.getSpecularColor());
+            char buf[64];
+            int n = std::snprintf(buf, sizeof(buf), ",%.6g,%.6g,%.6g", mtl.getShininess(), mtl.getOpacity(), mtl.getN());
+            out.append(buf, n);
+        }
+        out += "\n";
+    }
+
+    struct text_chunk
+    {
+        std::string in;
+        unsigned long long first_line = 0; // 1 based
+        std::string out;
+        u32 items = 0;
+        u32 errors = 0;
+        unsigned long long first_error = 0;
+    };
+
+    static void convertMaterials(text_chunk &chunk, u32 cols)
+    {
+        const char *s = chunk.in.data();
+        const char *end = s + chunk.in.size();
+        Material mtl;
+        material_params p;
+
+        for (unsigned long long line = chunk.first_line; s < end; ++line)
+        {
+            const char *eol = static_cast<const char *>(std::memchr(s, '\n', end - s));
+            eol = eol ? eol : end;
+            const char *e = (eol > s && eol[-1] == '\r') ? eol - 1 : eol;
+
+            while (s < e && (*s == ' ' || *s == '\t'))
+                ++s;
+            if (s < e && *s != '#')
+            {
+                bool ok = (*s == '{') ? parseJsonLine(s, e, p) : parseCsv(s, e, p);
+                if (ok && material_batch::create(p, mtl))
+                {
+                    appendMaterial(chunk.out, line, mtl, cols);
+                    ++chunk.items;
+                }
+                else if (line > 1) // first line may be a CSV header
+                {
+                    chunk.first_error = chunk.errors ? chunk.first_error : line;
+                    ++chunk.errors;
+                }
+            }
+            s = eol + 1;
+        }
+    }
+
+    static FILE *openFile(const char *path, bool write)
+    {
+        if (std::strcmp(path, "-") == 0)
+        {
+            FILE *f = write ? stdout : stdin;
+#ifdef _WIN32
+            _setmode(_fileno(f), _O_BINARY);
+#endif
+            return f;
+        }
+        FILE *f = std::fopen(path, write ? "wb" : "rb");
+        if (f)
+            std::setvbuf(f, nullptr, _IOFBF, size_t(1) << 20);
+        return f;
+    }
+
+    static int materials(FILE *in, FILE *out, u32 cols, u32 workers)
+    {
+        progress prg;
+        std::string carry;
+        unsigned long long line = 1;
+        bool eof = false;
+        bool failed = false;
+        unsigned long long first_error = 0;
+
+        std::string header;
+        appendHeader(header, cols);
+        std::fwrite(header.data(), 1, header.size(), out);
+
+        auto read = [&](text_chunk &chunk) -> bool
+        {
+            if (eof && carry.empty())
+                return false;
+
+            chunk.in.swap(carry);
+            carry.clear();
+            size_t cut = std::string::npos;
+            while (!eof && cut == std::string::npos)
+            {
+                size_t old = chunk.in.size();
+                chunk.in.resize(old + text_block);
+                size_t n = std::fread(&chunk.in[old], 1, text_block, in);
+                chunk.in.resize(old + n);
+                eof = n < text_block;
+                cut = chunk.in.rfind('\n');
+            }
+
+            // cut at the last full line, the rest goes to the next chunk
+            if (!eof && cut != std::string::npos)
+            {
+                carry.assign(chunk.in, cut + 1, std::string::npos);
+                chunk.in.resize(cut + 1);
+            }
+
+            chunk.first_line = line;
+            line += std::count(chunk.in.begin(), chunk.in.end(), '\n');
+            return !chunk.in.empty();
+        };
+
+        auto write = [&](text_chunk &chunk)
+        {
+            failed |= std::fwrite(chunk.out.data(), 1, chunk.out.size(), out) != chunk.out.size();
+            if (chunk.errors && !first_error)
+                first_error = chunk.first_error;
+            prg.add(chunk.in.size(), chunk.items, chunk.errors);
+        };
+
+        parallel_utils::ordered_pipeline<text_chunk>(read, [cols](text_chunk &chunk) { convertMaterials(chunk, cols); }, write, workers);
+        prg.report(true);
+        if (first_error)
+            std::fprintf(stderr, "invalid lines are skipped, first at %llu\n", first_error);
+        return failed ? 1 : 0;
+    }
+
+    struct binary_chunk
+    {
+        std::vector<float> in; // vl.rgb vd.rgb per point
+        std::vector<float> out; // c.rgb cg.rgb per point
+    };
+
+    static int colors(FILE *in, FILE *out, const material_params &params, u32 workers)
+    {
+        Material mtl;
+        if (!material_batch::create(params, mtl))
+        {
+            std::fprintf(stderr, "invalid material\n");
+            return 1;
+        }
+        const color3f cd = mtl.getDiffuseSpectrum();
+
+        progress prg;
+        bool failed = false;
+        bool partial = false;
+
+        auto read = [&](binary_chunk &chunk) -> bool
+        {
+            chunk.in.resize(size_t(points_block) * 6);
+            size_t n = std::fread(chunk.in.data(), sizeof(float), chunk.in.size(), in);
+            partial |= (n % 6) != 0;
+            chunk.in.resize(n - n % 6);
+            return !chunk.in.empty();
+        };
+
+        auto process = [&cd](binary_chunk &chunk)
+        {
+            size_t count = chunk.in.size() / 6;
+            chunk.out.resize(count * 6);
+            for (size_t i = 0; i < count; ++i)
+            {
+                const float *p = &chunk.in[i * 6];
+                color4f c, cg;
+                PuryaMesh::colorPoint(color3f(p[0] + p[3], p[1] + p[4], p[2] + p[5]), cd, c, cg);
+                float *o = &chunk.out[i * 6];
+                o[0] = c.r;
+                o[1] = c.g;
+                o[2] = c.b;
+                o[3] = cg.r;
+                o[4] = cg.g;
+                o[5] = cg.b;
+            }
+        };
+
+        auto write = [&](binary_chunk &chunk)
+        {
+            failed |= std::fwrite(chunk.out.data(), sizeof(float), chunk.out.size(), out) != chunk.out.size();
+            prg.add(chunk.in.size() * sizeof(float), u32(chunk.in.size() / 6));
+        };
+
+        parallel_utils::ordered_pipeline<binary_chunk>(read, process, write, workers);
+        prg.report(true);
+        if (partial)
+            std::fprintf(stderr, "input size is not a multiple of 24 bytes, the tail is ignored\n");
+        return (failed || partial) ? 1 : 0;
+    }
+
+    static void usage()
+    {
+        std::fprintf(stderr,
+                     "usage:\n"
+                     "  materials [-o spectra|graphics|all] [-j N] <in.csv|in.jsonl|-> <out.csv|->\n"
+                     "  colors -m type,r,g,b,refl_f,refl_c,trans[,n[,shin]] [-j N] <in.bin|-> <out.bin|->\n");
+    }
+
+    static int run(int argc, char **argv)
+    {
+        if (argc < 2)
+        {
+            usage();
+            return 2;
+        }
+
+        std::string mode = argv[1];
+        u32 cols = columns_all;
+        u32 workers = 0;
+        material_params mtl;
+        bool has_mtl = false;
+        std::vector<const char *> files;
+
+        for (int i = 2; i < argc; ++i)
+        {
+            std::string a = argv[i];
+            if (a == "-j" && i + 1 < argc)
+                workers = u32(std::atoi(argv[++i]));
+            else if (a == "-o" && i + 1 < argc)
+            {
+                std::string c = argv[++i];
+                cols = (c == "spectra") ? columns_spectra : (c == "graphics") ? columns_graphics : columns_all;
+            }
+            else if (a == "-m" && i + 1 < argc)
+            {
+                const char *m = argv[++i];
+                has_mtl = parseCsv(m, m + std::strlen(m), mtl);
+            }
+            else
+                files.push_back(argv[i]);
+        }
+
+        if (files.size() != 2 || (mode != "materials" && mode != "colors") || (mode == "colors" && !has_mtl))
+        {
+            usage();
+            return 2;
+        }
+
+        FILE *in = openFile(files[0], false);
+        FILE *out = in ? openFile(files[1], true) : nullptr;
+        if (!in || !out)
+        {
+            std::fprintf(stderr, "can't open %s\n", in ? files[1] : files[0]);
+            if (in && in != stdin)
+                std::fclose(in);
+            return 1;
+        }
+
+        int res = (mode == "materials") ? materials(in, out, cols, workers) : colors(in, out, mtl, workers);
+
+        if (in != stdin)
+            std::fclose(in);
+        if (out != stdout)
+            res |= std::fclose(out) ? 1 : 0;
+        else
+            std::fflush(out);
+        return res;
+    }
+}
@@ -0,0 +1,234 @@
+#include <iomanip>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <assert.h>
+#include <cstddef>
+#include <cstring>
+#include <memory_resource>
+
+#include "utils.h"
+#include "material_utils.h"
+#include "mesh_utils.h"
+#include "Spectrum.h"
+#include "Material.h"
+#include "memory_utils.h"
+#include "MaterialHandle.h"
+#include "parallel_utils.h"
+#include "material_batch.h"
+#include "PuryaMesh.h"
+#include "MaterialBuffer.h"
+#include "MaterialStore.h"
+
+#include "dialux_materials_api.h"
+
+// records are reinterpreted, not converted
+static_assert(sizeof(dm_material_params) == sizeof(material_params), "dm_material_params must match material_params");
+static_assert(offsetof(dm_material_params, type) == offsetof(material_params, type), "dm_material_params::type");
+static_assert(offsetof(dm_material_params, color) == offsetof(material_params, color), "dm_material_params::color");
+static_assert(offsetof(dm_material_params, reflection_factor) == offsetof(material_params, reflection_factor), "dm_material_params::reflection_factor");
+static_assert(offsetof(dm_material_params, reflection_coating) == offsetof(material_params, reflection_coating), "dm_material_params::reflection_coating");
+static_assert(offsetof(dm_material_params, transparency) == offsetof(material_params, transparency), "dm_material_params::transparency");
+static_assert(offsetof(dm_material_params, refractive) == offsetof(material_params, refractive), "dm_material_params::refractive");
+static_assert(offsetof(dm_material_params, shininess) == offsetof(material_params, shininess), "dm_material_params::shininess");
+
+static_assert(sizeof(dm_material_data) == sizeof(material_std140) + 12 * sizeof(float), "dm_material_data layout");
+static_assert(offsetof(dm_material_data, diffuse) == offsetof(material_std140, diffuse), "dm_material_data::diffuse");
+static_assert(offsetof(dm_material_data, shininess) == offsetof(material_std140, shininess), "dm_material_data::shininess");
+static_assert(offsetof(dm_material_data, ambient) == offsetof(material_std140, ambient), "dm_material_data::ambient");
+static_assert(offsetof(dm_material_data, opacity) == offsetof(material_std140, opacity), "dm_material_data::opacity");
+static_assert(offsetof(dm_material_data, specular) == offsetof(material_std140, specular), "dm_material_data::specular");
+static_assert(offsetof(dm_material_data, N) == offsetof(material_std140, N), "dm_material_data::N");
+
+struct dm_library
+{
+    MaterialStore materials;
+};
+
+namespace
+{
+    const material_params *params_cast(const dm_material_params *p)
+    {
+        return reinterpret_cast<const material_params *>(p);
+    }
+
+    void toFloats(const color3f &c, float *out)
+    {
+        out[0] = c.r;
+        out[1] = c.g;
+        out[2] = c.b;
+    }
+
+    void colorMesh(const Material &mtl, const dm_mesh &mesh, u32 begin, u32 end)
+    {
+        color3f cd = mtl.getDiffuseSpectrum();
+        for (u32 i = begin; i < end; ++i)
+        {
+            const float *vl = mesh.vl + size_t(i) * 3;
+            color3f vs(vl[0], vl[1], vl[2]);
+            if (mesh.vd)
+                vs += color3f(mesh.vd[size_t(i) * 3], mesh.vd[size_t(i) * 3 + 1], mesh.vd[size_t(i) * 3 + 2]);
+
+            color4f c, cg;
+            PuryaMesh::colorPoint(vs, cd, c, cg);
+            toFloats(c, mesh.c + size_t(i) * 3);
+            if (mesh.cg)
+                toFloats(cg, mesh.cg + size_t(i) * 3);
+        }
+    }
+}
+
+extern "C"
+{
+    DM_API uint32_t dm_version(void) { return DM_VERSION; }
+
+    DM_API int dm_library_create(uint32_t version, dm_library **library)
+    {
+        if (!library)
+            return DM_ERROR_ARGUMENT;
+        *library = nullptr;
+        if ((version >> 16) != DM_VERSION_MAJOR)
+            return DM_ERROR_VERSION;
+
+        try
+        {
+            *library = new dm_library();
+            return DM_OK;
+        }
+        catch (...)
+        {
+            return DM_ERROR_INTERNAL;
+        }
+    }
+
+    DM_API void dm_library_destroy(dm_library *library) { delete library; }
+
+    DM_API uint32_t dm_materials_count(const dm_library *library) { return library ? library->materials.getSize() : 0; }
+
+    DM_API int dm_materials_create(dm_library *library, const dm_material_params *params, uint32_t count, uint32_t *ids)
+    {
+        if (!library || (count && !params))
+            return DM_ERROR_ARGUMENT;
+
+        try
+        {
+            std::vector<Material> mtls(count);
+            if (material_batch::create(params_cast(params), count, mtls.data()))
+                return DM_ERROR_ARGUMENT;
+
+            for (u32 i = 0; i < count; ++i)
+            {
+                u32 id = library->materials.add(mtls[i]);
+                if (ids)
+                    ids[i] = id;
+            }
+            return DM_OK;
+        }
+        catch (...)
+        {
+            return DM_ERROR_INTERNAL;
+        }
+    }
+
+    DM_API int dm_materials_update(dm_library *library, const uint32_t *ids, const dm_material_params *params, uint32_t count)
+    {
+        if (!library || (count && (!ids || !params)))
+            return DM_ERROR_ARGUMENT;
+
+        try
+        {
+            for (u32 i = 0; i < count; ++i)
+            {
+                if (ids[i] >= library->materials.getSize())
+                    return DM_ERROR_INDEX;
+            }
+
+            std::vector<Material> mtls(count);
+            if (material_batch::create(params_cast(params), count, mtls.data()))
+                return DM_ERROR_ARGUMENT;
+
+            // readers see the old or the new version of each material
+            for (u32 i = 0; i < count; ++i)
+            {
+                mtls[i].setName(library->materials.get(ids[i]).getName());
+                library->materials.publish(ids[i], mtls[i]);
+            }
+            return DM_OK;
+        }
+        catch (...)
+        {
+            return DM_ERROR_INTERNAL;
+        }
+    }
+
+    DM_API int dm_materials_get(const dm_library *library, const uint32_t *ids, uint32_t count, dm_material_data *out)
+    {
+        if (!library || (count && (!ids || !out)))
+            return DM_ERROR_ARGUMENT;
+
+        MaterialStore::reader materials(library->materials);
+        for (u32 i = 0; i < count; ++i)
+        {
+            if (ids[i] >= materials.getSize())
+                return DM_ERROR_INDEX;
+
+            const Material &mtl = materials[ids[i]];
+            dm_material_data &d = out[i];
+            MaterialBuffer::pack(mtl, reinterpret_cast<material_std140 &>(d));
+            toFloats(mtl.getDiffuseSpectrum(), d.diffuse_spectrum);
+            toFloats(mtl.getSpecularSpectrum(), d.specular_spectrum);
+            toFloats(mtl.getTransmissionSpectrum(), d.transmission_spectrum);
+            d.reflection_factor = mtl.getReflectionFactor();
+            d.reflection_coating = mtl.getReflectionCoating();
+            d.transparency = mtl.getTransparency();
+        }
+        return DM_OK;
+    }
+
+    DM_API int dm_meshes_color(const dm_library *library, const dm_mesh *meshes, uint32_t count)
+    {
+        if (!library || (count && !meshes))
+            return DM_ERROR_ARGUMENT;
+
+        u32 size = library->materials.getSize();
+        for (u32 m = 0; m < count; ++m)
+        {
+            if (meshes[m].material >= size)
+                return DM_ERROR_INDEX;
+            if (meshes[m].count && (!meshes[m].vl || !meshes[m].c))
+                return DM_ERROR_ARGUMENT;
+        }
+
+        try
+        {
+            // many meshes - one task per mesh, few meshes - split the points
+            if (count >= parallel_utils::thread_count())
+            {
+                parallel_utils::parallel_for(0, count, 1, [&](u32 begin, u32 end)
+                {
+                    MaterialStore::reader materials(library->materials);
+                    for (u32 m = begin; m < end; ++m)
+                        colorMesh(materials[meshes[m].material], meshes[m], 0, meshes[m].count);
+                });
+            }
+            else
+            {
+                MaterialStore::reader materials(library->materials);
+                for (u32 m = 0; m < count; ++m)
+                {
+                    const Material &mtl = materials[meshes[m].material];
+                    parallel_utils::parallel_for(0, meshes[m].count, 4096, [&](u32 begin, u32 end)
+                    {
+                        colorMesh(mtl, meshes[m], begin, end);
+                    });
+                }
+            }
+            return DM_OK;
+        }
+        catch (...)
+        {
+            return DM_ERROR_INTERNAL;
+        }
+    }
+}
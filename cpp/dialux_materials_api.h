@@ -0,0 +1,110 @@
+#pragma once
+
+/*
+ * dialux_materials C ABI.
+ * All entry points work on whole arrays owned by the caller: nothing is copied across the
+ * boundary and no per-item calls are needed. Records are plain structs with fixed layout.
+ * Functions return DM_OK or an error code and never throw.
+ * All calls except dm_library_destroy may run concurrently on one library: an update publishes
+ * new material versions atomically, get / color calls see each material before or after it.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#ifdef DIALUX_MATERIALS_EXPORTS
+#define DM_API __declspec(dllexport)
+#else
+#define DM_API __declspec(dllimport)
+#endif
+#else
+#define DM_API __attribute__((visibility("default")))
+#endif
+
+/* major changes break the layout of the records below */
+#define DM_VERSION_MAJOR 1
+#define DM_VERSION_MINOR 0
+#define DM_VERSION ((DM_VERSION_MAJOR << 16) | DM_VERSION_MINOR)
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    enum dm_status
+    {
+        DM_OK = 0,
+        DM_ERROR_ARGUMENT = 1, /* null pointer or invalid material type */
+        DM_ERROR_INDEX = 2,    /* material id out of range */
+        DM_ERROR_VERSION = 3,  /* caller built against another major version */
+        DM_ERROR_INTERNAL = 4
+    };
+
+    enum dm_material_type
+    {
+        DM_TRANSPARENT = 1,
+        DM_METALLIC = 2,
+        DM_PAINTED = 3
+    };
+
+    /* Material::create arguments */
+    typedef struct dm_material_params
+    {
+        uint32_t type;
+        float color[3]; /* sRGB [0..1] */
+        float reflection_factor;
+        float reflection_coating;
+        float transparency;
+        float refractive;
+        float shininess;
+    } dm_material_params;
+
+    /* computed material: graphics colors (std140 row layout) + linear spectra */
+    typedef struct dm_material_data
+    {
+        float diffuse[3];
+        float shininess; /* Phong exponent [1..128] */
+        float ambient[3];
+        float opacity;
+        float specular[3];
+        float N;
+        float diffuse_spectrum[3];
+        float specular_spectrum[3];
+        float transmission_spectrum[3];
+        float reflection_factor;
+        float reflection_coating;
+        float transparency;
+    } dm_material_data;
+
+    /* one mesh to color: count calc points, interleaved rgb arrays of count * 3 floats */
+    typedef struct dm_mesh
+    {
+        uint32_t material;
+        uint32_t count;
+        const float *vl; /* direct illuminance [lx] */
+        const float *vd; /* diffuse illuminance [lx], may be NULL */
+        float *c;        /* out: luminance color (sRGB) */
+        float *cg;       /* out: gray illuminance color (sRGB), may be NULL */
+    } dm_mesh;
+
+    typedef struct dm_library dm_library;
+
+    DM_API uint32_t dm_version(void);
+
+    /* version - DM_VERSION the caller was compiled with */
+    DM_API int dm_library_create(uint32_t version, dm_library **library);
+    DM_API void dm_library_destroy(dm_library *library);
+
+    DM_API uint32_t dm_materials_count(const dm_library *library);
+
+    /* appends count materials, ids (may be NULL) receives their ids */
+    DM_API int dm_materials_create(dm_library *library, const dm_material_params *params, uint32_t count, uint32_t *ids);
+    DM_API int dm_materials_update(dm_library *library, const uint32_t *ids, const dm_material_params *params, uint32_t count);
+    DM_API int dm_materials_get(const dm_library *library, const uint32_t *ids, uint32_t count, dm_material_data *out);
+
+    DM_API int dm_meshes_color(const dm_library *library, const dm_mesh *meshes, uint32_t count);
+
+#ifdef __cplusplus
+}
+#endif
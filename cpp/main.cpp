@@ -4,19 +4,49 @@
 #include <string>
 #include <iostream>
 #include <assert.h>
+#include <memory_resource>
 
 #include "utils.h"
 #include "material_utils.h"
 #include "mesh_utils.h"
+#include "Spectrum.h"
 #include "Material.h"
 #include "log.h"
-#include "tests.h"
-#include "mesh_utils.h"
+#include "memory_utils.h"
+#include "MaterialHandle.h"
+#include "parallel_utils.h"
+#include "material_batch.h"
 #include "PuryaMesh.h"
+#include "CalcSurfaceIndex.h"
+#include "GridSurface.h"
+#include "LightGroups.h"
+#include "DaylightSeries.h"
+#include "Photometry.h"
+#include "Radiosity.h"
+#include "ViewLuminance.h"
+#include "MaterialFit.h"
+#include "MaterialCatalog.h"
+#include "TextureTint.h"
+#include "MaterialBuffer.h"
+#include "MaterialService.h"
+#include "batch_tool.h"
+#include "JsonLoader.h"
+#include "MaterialStore.h"
+#include "MaterialEditQueue.h"
+#include "ColorCache.h"
+#include "ColorPipeline.h"
+#include "SceneScheduler.h"
+#include "MaterialBlend.h"
+#include "MaterialPreview.h"
+#include "dialux_materials_api.h"
+#include "tests.h"
 
 // Main ----------------------------------------------------------------
-int main()
+int main(int argc, char **argv)
 {
+    if (argc > 1)
+        return batch_tool::run(argc, argv);
+
     std::cout << std::fixed << std::setprecision(2);
 
     Material mtl;
@@ -98,6 +128,38 @@ int main()
         tests::test_end(mtl, 0.1f, 0.1f, 0.1f, 0.2f);
     }
 
+    if (0)
+    {
+        tests::test_scene_arena();
+        tests::test_material_handles(mtl);
+        tests::test_calc_interpolation();
+        tests::test_grid_surface(mtl);
+        tests::test_material_service();
+        tests::test_material_handle_edit();
+        tests::test_material_blend();
+        tests::test_material_edit_queue();
+        tests::test_material_buffer_pack();
+        tests::test_photometry();
+        tests::test_material_store(mtl);
+        tests::test_c_api();
+        tests::test_color_cache(mtl);
+        tests::test_material_fit();
+        tests::test_spectral();
+        tests::test_light_groups(mtl);
+        tests::test_json_loader();
+        tests::test_texture_tint();
+        tests::test_daylight_series(mtl);
+        tests::test_radiosity();
+        tests::test_view_luminance();
+        tests::test_material_catalog();
+        tests::test_ordered_pipeline();
+        tests::test_color_pipeline();
+        tests::test_scene_scheduler();
+        tests::test_material_preview();
+        tests::test_material_buffer();
+        tests::test_material_service_http();
+    }
+
     // test Mesh Color
     if (1)
     {
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+
+// Material::create arguments as one record (C ABI / service / loaders share this layout)
+struct material_params
+{
+    u32 type;
+    float color[3]; ///< sRGB
+    float reflection_factor;
+    float reflection_coating;
+    float transparency;
+    float refractive;
+    float shininess;
+};
+
+namespace material_batch
+{
+    static bool isValid(const material_params &p)
+    {
+        return p.type >= material_type::transparent && p.type <= material_type::painted;
+    }
+
+    static bool create(const material_params &p, Material &mtl, const char *name = "material")
+    {
+        if (!isValid(p))
+            return false;
+
+        color3f color(p.color[0], p.color[1], p.color[2]);
+        return mtl.create("", name, p.type, color, p.reflection_factor, p.reflection_coating, p.transparency, p.refractive, p.shininess);
+    }
+
+    // out[count], returns the number of invalid records (their materials are left untouched)
+    static u32 create(const material_params *params, u32 count, Material *out)
+    {
+        std::atomic<u32> failed{0};
+        parallel_utils::parallel_for(0, count, 256, [&](u32 begin, u32 end)
+        {
+            for (u32 i = begin; i < end; ++i)
+            {
+                if (!create(params[i], out[i]))
+                    ++failed;
+            }
+        });
+        return failed;
+    }
+}
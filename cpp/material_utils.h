@@ -108,6 +108,12 @@ namespace material_utils
         return from_linear(luminance / K);
     }
 
+    // Material shininess [0..1] -> Phong exponent [1..128]
+    static float to_phong_exponent(float shininess)
+    {
+        return 1.0f + 127.0f * shininess;
+    }
+
     // static float getY(u32 type, float reflection_factor, float reflection_coating, float transparency)
     //{
     //     if (type == material_type::undefined)
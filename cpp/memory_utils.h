@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <memory_resource>
+
+namespace memory_utils
+{
+    // counting_resource - forwards to upstream and counts every call (for verification)
+    class counting_resource : public std::pmr::memory_resource
+    {
+        std::pmr::memory_resource *m_upstream;
+
+        std::atomic<size_t> m_allocations{0};
+        std::atomic<size_t> m_deallocations{0};
+        std::atomic<size_t> m_bytes_allocated{0};
+        std::atomic<size_t> m_bytes_in_use{0};
+
+    public:
+        explicit counting_resource(std::pmr::memory_resource *upstream = std::pmr::new_delete_resource())
+            : m_upstream(upstream)
+        {
+        }
+
+        size_t allocations() const { return m_allocations; }
+        size_t deallocations() const { return m_deallocations; }
+        size_t bytesAllocated() const { return m_bytes_allocated; }
+        size_t bytesInUse() const { return m_bytes_in_use; }
+
+        void resetCounters()
+        {
+            m_allocations = 0;
+            m_deallocations = 0;
+            m_bytes_allocated = 0;
+        }
+
+    private:
+        void *do_allocate(size_t bytes, size_t alignment) override
+        {
+            void *p = m_upstream->allocate(bytes, alignment);
+            ++m_allocations;
+            m_bytes_allocated += bytes;
+            m_bytes_in_use += bytes;
+            return p;
+        }
+
+        void do_deallocate(void *p, size_t bytes, size_t alignment) override
+        {
+            m_upstream->deallocate(p, bytes, alignment);
+            ++m_deallocations;
+            m_bytes_in_use -= bytes;
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+        {
+            return this == &other;
+        }
+    };
+
+    // SceneArena - monotonic arena for the lifetime of a scene.
+    // Meshes built on resource() never free individually, release() returns
+    // all blocks to upstream at once.
+    class SceneArena
+    {
+        counting_resource m_counter;
+        std::pmr::monotonic_buffer_resource m_arena;
+
+    public:
+        static const size_t default_block_size = 1 << 20; // 1 MB
+
+        explicit SceneArena(size_t initial_size = default_block_size,
+                            std::pmr::memory_resource *upstream = std::pmr::new_delete_resource())
+            : m_counter(upstream), m_arena(initial_size, &m_counter)
+        {
+        }
+
+        SceneArena(const SceneArena &) = delete;
+        SceneArena &operator=(const SceneArena &) = delete;
+
+        std::pmr::memory_resource *resource() { return &m_arena; }
+
+        // upstream counters: number of blocks requested by the arena, not number of meshes
+        const counting_resource &counters() const { return m_counter; }
+
+        void release() { m_arena.release(); }
+    };
+}
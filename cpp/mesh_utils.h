@@ -8,7 +8,7 @@ namespace mesh_utils
     static const float k3 = 0.33333333333333333f; // 1/3
     static const float PI = 3.14159265358979324f;
 
-    void color_check(color4f& c)
+    static void color_check(color4f& c)
     {
         float mx = c.max();
         if (mx > 1){
@@ -19,7 +19,7 @@ namespace mesh_utils
     // c - illum_rgb ([0, Inf],[0,Inf],[0,Inf])
     // nmv - max [0,Inf]
     // return norm rgb [0,1]
-    void color_normalize(color4f& c, float nmv)
+    static void color_normalize(color4f& c, float nmv)
     {
         nmv /= 3;
         float mx = c.max();
@@ -33,25 +33,39 @@ namespace mesh_utils
 
     // Y - relative luminance [0,1]
     // return perceptual lightness [0,1]
-    float Y2LS(float Y) { return (Y > k1) ? std::pow(Y, k3) * 1.16f - 0.16f : Y * k2;}
+    static float Y2LS(float Y) { return (Y > k1) ? std::pow(Y, k3) * 1.16f - 0.16f : Y * k2;}
+
+    // t - X/Xn, Y/Yn or Z/Zn
+    // return CIELAB f(t), Y2LS(Y) = 1.16 * lab_f(Y) - 0.16
+    static float lab_f(float t) { return (t > k1) ? std::pow(t, k3) : (t * k2 + 0.16f) / 1.16f; }
+
+    // c - sRGB ([0,1][0,1][0,1])
+    // return CIELAB (L [0,100], a, b), D65 white
+    static color3f to_lab(const color3f& c) {
+        color3f l = material_utils::to_linear(c);
+        float fx = lab_f((0.4124f * l.r + 0.3576f * l.g + 0.1805f * l.b) / 0.95047f);
+        float fy = lab_f(0.2126f * l.r + 0.7152f * l.g + 0.0722f * l.b);
+        float fz = lab_f((0.0193f * l.r + 0.1192f * l.g + 0.9505f * l.b) / 1.08883f);
+        return color3f(116.0f * fy - 16.0f, 500.0f * (fx - fy), 200.0f * (fy - fz));
+    }
 
     // Y - relative luminance [0,1]
     // b - number to pow [0,1]
     // return pow lightness 
-    float Y2Pow(float Y, float b = 0.333333f) { return pow(Y, b); }
+    static float Y2Pow(float Y, float b = 0.333333f) { return pow(Y, b); }
 
 
     // illum - illuminance [0, Inf]
     // diff_f - Diffuze reflrcting factor [0, 1]
     // return luminance color [0, Inf]
-    float illum_to_lum(const float& illum, const float& diff_f) {
+    static float illum_to_lum(const float& illum, const float& diff_f) {
         return illum * diff_f / PI;
     }
 
     // illum - illuminance ([0, Inf],[0,Inf],[0,Inf])
     // diff_f - Diffuze reflrcting factor [0, 1]
     // return luminance color ([0, Inf],[0,Inf],[0,Inf])
-    color3f illum_to_lum(  color3f& illum,   color3f &diff_f) {
+    static color3f illum_to_lum(  color3f& illum,   color3f &diff_f) {
         return illum * (diff_f / PI);
     }
 
@@ -59,7 +73,7 @@ namespace mesh_utils
     // c - linear RGB ([0,1][0,1][0,1])
     // b - pow contrast coeff [0,1]
     // return contrast color ([0,1][0,1][0,1])
-    void convert(color4f& c, float b = 0.0f)
+    static void convert(color4f& c, float b = 0.0f)
     {
         float Y = c.sum() / 3.0f;
         float Ynew;
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace parallel_utils
+{
+    static u32 thread_count()
+    {
+        u32 count = std::thread::hardware_concurrency();
+        return count ? count : 1;
+    }
+
+    // fn(begin, end) is called for chunks of [begin, end) of at most grain items.
+    // Chunks are taken dynamically, so uneven chunk costs are balanced.
+    template <class F>
+    void parallel_for(u32 begin, u32 end, u32 grain, F fn, u32 threads = 0)
+    {
+        if (end <= begin)
+            return;
+
+        grain = std::max(grain, 1u);
+        u32 chunks = (end - begin + grain - 1) / grain;
+        threads = std::min(threads ? threads : thread_count(), chunks);
+
+        if (threads <= 1)
+        {
+            for (u32 b = begin; b < end; b += std::min(grain, end - b))
+            {
+                fn(b, b + std::min(grain, end - b));
+            }
+            return;
+        }
+
+        std::atomic<u32> next(0);
+        auto worker = [&]()
+        {
+            for (u32 chunk = next++; chunk < chunks; chunk = next++)
+            {
+                u32 b = begin + chunk * grain;
+                fn(b, std::min(b + grain, end));
+            }
+        };
+
+        std::vector<std::thread> pool;
+        pool.reserve(threads - 1);
+        for (u32 i = 1; i < threads; ++i)
+        {
+            pool.emplace_back(worker);
+        }
+        worker();
+        for (std::thread &t : pool)
+        {
+            t.join();
+        }
+    }
+
+    // Streaming pipeline: read(T&) -> bool (false - end of input) runs on the calling thread,
+    // process(T&) on workers, write(T&) on one writer thread in input order.
+    // At most capacity items are in flight, read waits for the writer (back-pressure).
+    template <class T, class R, class P, class W>
+    void ordered_pipeline(R read, P process, W write, u32 workers = 0, u32 capacity = 0)
+    {
+        workers = workers ? workers : thread_count();
+        capacity = capacity ? capacity : 2 * workers + 2;
+
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<std::pair<u32, std::unique_ptr<T>>> todo;
+        std::map<u32, std::unique_ptr<T>> done; // reorder buffer
+        u32 in_flight = 0;
+        u32 next_write = 0;
+        bool eof = false;
+
+        auto worker = [&]()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true)
+            {
+                cv.wait(lock, [&]() { return !todo.empty() || eof; });
+                if (todo.empty())
+                    return;
+
+                std::pair<u32, std::unique_ptr<T>> item = std::move(todo.front());
+                todo.pop_front();
+                lock.unlock();
+                process(*item.second);
+                lock.lock();
+                done.emplace(item.first, std::move(item.second));
+                cv.notify_all();
+            }
+        };
+
+        auto writer = [&]()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true)
+            {
+                cv.wait(lock, [&]() { return done.count(next_write) || (eof && !in_flight); });
+                auto it = done.find(next_write);
+                if (it == done.end())
+                    return;
+
+                std::unique_ptr<T> item = std::move(it->second);
+                done.erase(it);
+                lock.unlock();
+                write(*item);
+                item.reset();
+                lock.lock();
+                --in_flight;
+                ++next_write;
+                cv.notify_all();
+            }
+        };
+
+        std::vector<std::thread> pool;
+        for (u32 i = 0; i < workers; ++i)
+            pool.emplace_back(worker);
+        std::thread out(writer);
+
+        for (u32 seq = 0;; ++seq)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&]() { return in_flight < capacity; });
+            }
+
+            std::unique_ptr<T> item(new T());
+            if (!read(*item))
+                break;
+
+            std::lock_guard<std::mutex> lock(mutex);
+            todo.emplace_back(seq, std::move(item));
+            ++in_flight;
+            cv.notify_all();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            eof = true;
+            cv.notify_all();
+        }
+        for (std::thread &t : pool)
+            t.join();
+        out.join();
+    }
+}
@@ -2,12 +2,12 @@
 
 namespace tests
 {
-    float round_to(float value, unsigned int rate)
+    static float round_to(float value, unsigned int rate)
     {
         return round(value * pow(10, rate)); /// pow(10, rate)
     }
 
-    color3f round_to(color3f color, unsigned int rate)
+    static color3f round_to(color3f color, unsigned int rate)
     {
         color.r = round_to(color.r, rate);
         color.g = round_to(color.g, rate);
@@ -15,7 +15,7 @@ namespace tests
         return color;
     }
 
-    void material_error(Material mtl, bool is_not_error)
+    static void material_error(Material mtl, bool is_not_error)
     {
         if (!is_not_error)
         {
@@ -37,21 +37,21 @@ namespace tests
     //     material_error(mtl, p == value);
     // }
 
-    void test_param(Material mtl, unsigned int accuracy, float param, float value)
+    static void test_param(Material mtl, unsigned int accuracy, float param, float value)
     {
         float p = round_to(param, accuracy);
         value = round_to(value, accuracy);
         material_error(mtl, p == value);
     }
 
-    void test_param(Material mtl, unsigned int accuracy, color3f color, color3f value)
+    static void test_param(Material mtl, unsigned int accuracy, color3f color, color3f value)
     {
         color3f c = round_to(color, accuracy);
         value = round_to(value, accuracy);
         material_error(mtl, c == value);
     }
 
-    void test_material_params(Material mtl, unsigned int accuracy,
+    static void test_material_params(Material mtl, unsigned int accuracy,
         float reflection_factor = -1,
         float reflection_coating = -1,
         float transparency = -1)
@@ -70,7 +70,7 @@ namespace tests
         }
     }
 
-    void test_material_colors(Material mtl, unsigned int accuracy,
+    static void test_material_colors(Material mtl, unsigned int accuracy,
         color3f diffuse = color3f(-1),
         color3f specular = color3f(-1),
         color3f transmission = color3f(-1))
@@ -89,7 +89,7 @@ namespace tests
         }
     }
 
-    void test_material(Material mtl, unsigned int accuracy,
+    static void test_material(Material mtl, unsigned int accuracy,
         float reflection_factor, float reflection_coating = -1, float transparency = -1,
         color3f diffuse = color3f(-1), color3f specular = color3f(-1), color3f transmission = color3f(-1))
     {
@@ -97,7 +97,7 @@ namespace tests
         test_material_colors(mtl, accuracy, diffuse, specular, transmission);
     }
 
-    void material_1_test(Material mtl)
+    static void material_1_test(Material mtl)
     {
         if (!mtl.isValidSpectrums())
         {
@@ -111,7 +111,7 @@ namespace tests
         }
     }
 
-    void test_input_color(Material mtl, float color_step = 0.1f)
+    static void test_input_color(Material mtl, float color_step = 0.1f)
     {
         u32 color_count = 1.0f / color_step;
 
@@ -140,7 +140,7 @@ namespace tests
         }
     }
 
-    void test_type(Material mtl, float color_step = 0.1f)
+    static void test_type(Material mtl, float color_step = 0.1f)
     {
         for (u32 t = material_type::transparent; t <= material_type::painted; ++t)
         {
@@ -150,7 +150,7 @@ namespace tests
         }
     }
 
-    void test_end(Material mtl, float reflection_factor_step, float reflection_coating_step, float transperancy_step, float color_step = 0.1f)
+    static void test_end(Material mtl, float reflection_factor_step, float reflection_coating_step, float transperancy_step, float color_step = 0.1f)
     {
         u32 reflection_factor_count = 0.9f / reflection_factor_step;
         u32 reflection_coating_count = 1.0f / reflection_coating_step;
@@ -187,4 +187,1798 @@ namespace tests
         }
     }
 
+    // whole scene on one arena: upstream allocations must not grow with the number of meshes
+    static void test_scene_arena(u32 mesh_count = 1000, u32 p_count = 100)
+    {
+        memory_utils::SceneArena arena;
+
+        vertex point = vertex();
+        point.vl = color3f(100.0f, 200.0f, 200.0f);
+
+        {
+            std::pmr::vector<PuryaMesh *> meshes(arena.resource());
+            for (u32 i = 0; i < mesh_count; ++i)
+            {
+                PuryaMesh *mesh = new PuryaMesh(arena.resource());
+                mesh->setPoints(point, p_count);
+                meshes.push_back(mesh);
+            }
+            for (PuryaMesh *mesh : meshes)
+            {
+                delete mesh;
+            }
+        }
+
+        size_t bytes = size_t(mesh_count) * p_count * sizeof(vertex);
+        size_t blocks = arena.counters().allocations();
+        arena.release();
+
+        if (blocks > 64 || arena.counters().bytesAllocated() < bytes || arena.counters().bytesInUse() != 0)
+        {
+            cout << "Error: scene arena -----------------------------------------------" << endl;
+            cout << "blocks: " << blocks << " bytes: " << arena.counters().bytesAllocated() << " in use: " << arena.counters().bytesInUse() << endl;
+        }
+    }
+
+    // meshes share one material version, an edit publishes once for all of them
+    static void test_material_handles(Material mtl, u32 mesh_count = 100)
+    {
+        MaterialHandle handle(mtl);
+
+        std::vector<PuryaMesh *> meshes;
+        for (u32 i = 0; i < mesh_count; ++i)
+        {
+            PuryaMesh *mesh = new PuryaMesh();
+            mesh->setMaterial(handle);
+            meshes.push_back(mesh);
+        }
+
+        handle.edit([](Material &m) { return m.updateReflectionFactor(0.3f); });
+
+        bool is_valid = (handle.snapshot().use_count() == 2); // handle slot + snapshot
+        for (PuryaMesh *mesh : meshes)
+        {
+            const Material &m = mesh->getGeometry()->getMaterial();
+            is_valid = is_valid && (&m == &handle.get()) && (m.getReflectionFactor() == 0.3f);
+            delete mesh;
+        }
+
+        material_error(handle.get(), is_valid);
+    }
+
+    // linear illuminance on a calc grid must be reproduced exactly on a denser render grid
+    static void test_calc_interpolation(u32 calc_n = 8, u32 render_n = 64)
+    {
+        PuryaMesh calc;
+        calc.setPoints(vertex(), calc_n * calc_n);
+        Geometry &g = *calc.getGeometry();
+
+        for (u32 j = 0; j < calc_n; ++j)
+        {
+            for (u32 i = 0; i < calc_n; ++i)
+            {
+                vertex *v = g[j * calc_n + i];
+                v->p.set(float(i), float(j), 0.0f);
+                v->vl.set(100.0f + 10.0f * i + 5.0f * j);
+            }
+        }
+
+        std::vector<u32> idx;
+        for (u32 j = 0; j + 1 < calc_n; ++j)
+        {
+            for (u32 i = 0; i + 1 < calc_n; ++i)
+            {
+                u32 a = j * calc_n + i;
+                u32 quad[6] = {a, a + 1, a + calc_n, a + 1, a + calc_n + 1, a + calc_n};
+                idx.insert(idx.end(), quad, quad + 6);
+            }
+        }
+        g.setTriangles(idx.data(), u32(idx.size() / 3));
+
+        CalcSurfaceIndex index;
+        index.build(g);
+
+        std::vector<vertex> render(render_n * render_n);
+        float step = float(calc_n - 1) / (render_n - 1);
+        for (u32 j = 0; j < render_n; ++j)
+        {
+            for (u32 i = 0; i < render_n; ++i)
+            {
+                render[j * render_n + i].p.set(i * step, j * step, 0.1f);
+            }
+        }
+        index.interpolate(render.data(), u32(render.size()));
+
+        float err = 0.0f;
+        for (const vertex &v : render)
+        {
+            err = std::max(err, std::abs(v.vl.r - (100.0f + 10.0f * v.p.x + 5.0f * v.p.y)));
+        }
+
+        if (err > 0.01f)
+        {
+            cout << "Error: calc interpolation (" << err << ") -----------------------" << endl;
+        }
+    }
+
+    // grid surface colors must match PuryaMesh colors for the same illuminance
+    static void test_grid_surface(Material mtl, u32 nu = 100, u32 nv = 70)
+    {
+        GridSurface grid;
+        grid.create(vec3f(), vec3f(1.0f, 0.0f, 0.0f), vec3f(0.0f, 1.0f, 0.0f), 0.5f, 0.5f, nu, nv);
+        grid.setMaterial(mtl);
+
+        PuryaMesh mesh;
+        mesh.setPoints(vertex(), nu * nv);
+        mesh.setMaterial(mtl);
+
+        for (u32 j = 0; j < nv; ++j)
+        {
+            for (u32 i = 0; i < nu; ++i)
+            {
+                color3f vl(10.0f * i, 5.0f * j, 100.0f);
+                color3f vd(20.0f, 30.0f, 60.0f);
+                grid.setIlluminance(i, j, vl, vd);
+
+                vertex *v = (*mesh.getGeometry())[j * nu + i];
+                v->vl = vl;
+                v->vd = vd;
+            }
+        }
+
+        grid.normalizeColor(16);
+        mesh.normalizeColor();
+
+        bool is_valid = true;
+        for (u32 j = 0; j < nv; ++j)
+        {
+            for (u32 i = 0; i < nu; ++i)
+            {
+                vertex *v = (*mesh.getGeometry())[j * nu + i];
+                is_valid = is_valid && (grid.getColor(i, j) == v->c) && (grid.getColorGray(i, j) == v->cg.r);
+            }
+        }
+
+        material_error(mtl, is_valid);
+    }
+
+    // localhost round trip: results must match the in-process computation, idle keep-alive clients must not block others
+    static void test_material_service()
+    {
+        MaterialService service;
+        service.idle_timeout = 400;
+        if (!service.start(0, 1))
+        {
+            cout << "Error: material service start -----------------------------------" << endl;
+            return;
+        }
+
+        service_material_in in[2] = {{material_type::painted, {0.8f, 0.4f, 0.2f}, 0.6f, 0.3f, 1.0f, 1.0f, 0.5f},
+                                     {material_type::transparent, {0.2f, 0.5f, 0.9f}, 0.2f, 0.0f, 0.6f, 1.5f, 0.3f}};
+        std::string body(sizeof(service_header) + sizeof(in), '\0'), response;
+        service_header h;
+        h.count = 2;
+        std::memcpy(&body[0], &h, sizeof(h));
+        std::memcpy(&body[sizeof(h)], in, sizeof(in));
+
+        // an idle keep-alive connection takes the only worker until idle_timeout
+        service_utils::socket_t idle = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<unsigned short>(service.getPort()));
+        inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+        bool is_valid = connect(idle, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0;
+
+        is_valid = is_valid && MaterialService::request(service.getPort(), "/materials", body, response) == 200 &&
+                   response.size() == sizeof(service_header) + 2 * sizeof(service_material_out);
+        for (u32 i = 0; is_valid && i < 2; ++i)
+        {
+            Material mtl;
+            material_batch::create(in[i], mtl);
+            service_material_out r;
+            std::memcpy(&r, response.data() + sizeof(service_header) + i * sizeof(r), sizeof(r));
+            material_std140 g;
+            MaterialBuffer::pack(mtl, g);
+            is_valid = std::memcmp(&r.graphics, &g, sizeof(g)) == 0 && r.diffuse_spectrum[1] == mtl.getDiffuseSpectrum().g &&
+                       r.transmission_spectrum[2] == mtl.getTransmissionSpectrum().b && r.transparency == mtl.getTransparency();
+        }
+
+        service_point p = {{100.0f, 200.0f, 300.0f}, {20.0f, 30.0f, 60.0f}};
+        body.resize(sizeof(service_header) + sizeof(service_material_in) + sizeof(p));
+        h.count = 1;
+        std::memcpy(&body[0], &h, sizeof(h));
+        std::memcpy(&body[sizeof(h)], &in[0], sizeof(in[0]));
+        std::memcpy(&body[sizeof(h) + sizeof(in[0])], &p, sizeof(p));
+        is_valid = is_valid && MaterialService::request(service.getPort(), "/color", body, response) == 200;
+        if (is_valid)
+        {
+            Material mtl;
+            material_batch::create(in[0], mtl);
+            color4f c, cg;
+            PuryaMesh::colorPoint(color3f(120.0f, 230.0f, 360.0f), mtl.getDiffuseSpectrum(), c, cg);
+            service_color r;
+            std::memcpy(&r, response.data() + sizeof(service_header), sizeof(r));
+            is_valid = r.c[0] == c.r && r.c[2] == c.b && r.cg[1] == cg.g;
+        }
+
+        body[0] = 'X'; // bad magic
+        is_valid = is_valid && MaterialService::request(service.getPort(), "/color", body, response) == 400;
+        is_valid = is_valid && MaterialService::request(service.getPort(), "/nothing", body, response) == 404;
+
+        service_utils::closeSocket(idle);
+        service.stop();
+
+        if (!is_valid || service.getRequestsCount() != 4)
+        {
+            cout << "Error: material service ------------------------------------------" << endl;
+        }
+    }
+
+    // copy-on-write edits must give the same material as editing in place (copies keep the transition coefficients)
+    static void test_material_handle_edit()
+    {
+        bool is_valid = true;
+        for (u32 from = material_type::transparent; from <= material_type::painted; ++from)
+        {
+            for (u32 to = material_type::transparent; to <= material_type::painted; ++to)
+            {
+                Material mtl;
+                mtl.create("", "handle", from, color3f(0.4f, 0.2f, 0.2f), 0.59f, 0.36f, 0.3f, 1.2f, 0.5f);
+                MaterialHandle handle(mtl);
+
+                mtl.updateType(to);
+                handle.edit([to](Material &m) { return m.updateType(to); });
+
+                const Material &m = handle.get();
+                is_valid = is_valid && m.getType() == mtl.getType() && m.getReflectionFactor() == mtl.getReflectionFactor() &&
+                           m.getReflectionCoating() == mtl.getReflectionCoating() && m.getTransparency() == mtl.getTransparency() &&
+                           color3f(m.getDiffuseSpectrum()) == mtl.getDiffuseSpectrum() && color3f(m.getSpecularSpectrum()) == mtl.getSpecularSpectrum() &&
+                           color3f(m.getTransmissionSpectrum()) == mtl.getTransmissionSpectrum();
+                if (!is_valid)
+                {
+                    cout << "Error: handle edit " << from << " -> " << to << " -----------------------------------" << endl;
+                    logMaterial(m);
+                    logMaterial(mtl);
+                    return;
+                }
+            }
+        }
+    }
+
+    // blended states: the ends are reproduced, every state conserves energy, a type transition ends at updateType
+    static void test_material_blend()
+    {
+        auto near_color = [](const color3f &a, const color3f &b) { return std::fabs(a.r - b.r) < 1e-4f && std::fabs(a.g - b.g) < 1e-4f && std::fabs(a.b - b.b) < 1e-4f; };
+        auto near_material = [&](const Material &a, const Material &b)
+        {
+            return a.getType() == b.getType() && std::fabs(a.getReflectionFactor() - b.getReflectionFactor()) < 1e-4f &&
+                   std::fabs(a.getReflectionCoating() - b.getReflectionCoating()) < 1e-4f && std::fabs(a.getTransparency() - b.getTransparency()) < 1e-4f &&
+                   std::fabs(a.getRefractive() - b.getRefractive()) < 1e-4f && near_color(a.getDiffuseSpectrum(), b.getDiffuseSpectrum()) &&
+                   near_color(a.getSpecularSpectrum(), b.getSpecularSpectrum()) && near_color(a.getTransmissionSpectrum(), b.getTransmissionSpectrum()) &&
+                   near_color(a.getDiffuseColor(), b.getDiffuseColor()) && near_color(a.getSpecularColor(), b.getSpecularColor());
+        };
+
+        Material mtl[3];
+        mtl[0].create("", "blend0", material_type::painted, color3f(0.8f, 0.3f, 0.1f), 0.7f, 0.2f, 0.0f, 1.0f, 0.5f);
+        mtl[1].create("", "blend1", material_type::metallic, color3f(0.2f, 0.4f, 0.9f), 0.5f, 0.8f, 0.0f, 1.0f, 0.5f);
+        mtl[2].create("", "blend2", material_type::transparent, color3f(0.9f, 0.9f, 0.8f), 0.1f, 0.0f, 0.85f, 1.5f, 0.5f);
+
+        const u32 count = 17;
+        Material strip[count];
+        for (const Material &a : mtl)
+        {
+            for (const Material &b : mtl)
+            {
+                Material state;
+                material_blend::blend(a, b, 0.0f, state);
+                if (!near_material(state, a))
+                {
+                    cout << "Error: blend " << a.getName() << " -> " << b.getName() << " at t = 0 -----------------------------------" << endl;
+                    logMaterial(state);
+                    return;
+                }
+                material_blend::blend(a, b, 1.0f, state);
+                if (!near_material(state, b))
+                {
+                    cout << "Error: blend " << a.getName() << " -> " << b.getName() << " at t = 1 -----------------------------------" << endl;
+                    logMaterial(state);
+                    return;
+                }
+
+                if (!material_blend::strip(a, b, count, strip))
+                {
+                    cout << "Error: blend strip " << a.getName() << " -> " << b.getName() << " rejected -----------------------------------" << endl;
+                    return;
+                }
+                for (u32 i = 0; i < count; ++i)
+                {
+                    if (!strip[i].isValidSpectrums())
+                    {
+                        cout << "Error: blend strip " << a.getName() << " -> " << b.getName() << " state " << i << " -----------------------------------" << endl;
+                        logMaterial(strip[i]);
+                        return;
+                    }
+                }
+            }
+
+            for (u32 type = material_type::transparent; type <= material_type::painted; ++type)
+            {
+                Material target = a;
+                target.updateType(type);
+                if (!material_blend::typeTransition(a, type, count, strip) || !near_material(strip[0], a) || !near_material(strip[count - 1], target))
+                {
+                    cout << "Error: type transition " << a.getName() << " -> " << type << " -----------------------------------" << endl;
+                    logMaterial(strip[count - 1]);
+                    logMaterial(target);
+                    return;
+                }
+            }
+        }
+    }
+
+    // edit queue: a batch gives the material of the same edits applied one by one, flush waits for on_applied
+    static void test_material_edit_queue()
+    {
+        auto near_material = [](const Material &a, const Material &b)
+        {
+            auto near_color = [](const color3f &x, const color3f &y) { return std::fabs(x.r - y.r) < 1e-5f && std::fabs(x.g - y.g) < 1e-5f && std::fabs(x.b - y.b) < 1e-5f; };
+            return a.getType() == b.getType() && std::fabs(a.getReflectionFactor() - b.getReflectionFactor()) < 1e-5f &&
+                   std::fabs(a.getReflectionCoating() - b.getReflectionCoating()) < 1e-5f && std::fabs(a.getTransparency() - b.getTransparency()) < 1e-5f &&
+                   std::fabs(a.getRefractive() - b.getRefractive()) < 1e-5f && near_color(a.getDiffuseSpectrum(), b.getDiffuseSpectrum()) &&
+                   near_color(a.getSpecularSpectrum(), b.getSpecularSpectrum()) && near_color(a.getTransmissionSpectrum(), b.getTransmissionSpectrum());
+        };
+
+        Material mtl;
+        mtl.create("", "queue", material_type::painted, color3f(0.6f, 0.5f, 0.3f), 0.6f, 0.2f, 0.0f, 1.0f, 0.5f);
+
+        // a later type edit must not move ahead of the transparency edit made for the earlier type
+        std::vector<std::vector<material_edit>> batches = {
+            {{0, edit_type, {float(material_type::transparent)}}, {0, edit_transparency, {0.5f}}, {0, edit_type, {float(material_type::painted)}}},
+            {{0, edit_type, {float(material_type::transparent)}}, {0, edit_transparency, {0.5f}}, {0, edit_type, {float(material_type::metallic)}},
+             {0, edit_type, {float(material_type::transparent)}}},
+            {{0, edit_reflection_factor, {0.1f}}, {0, edit_reflection_factor, {0.3f}}, {1, edit_reflection_factor, {0.2f}}, {0, edit_reflection_coating, {0.4f}},
+             {0, edit_reflection_factor, {0.5f}}, {1, edit_color, {0.1f, 0.7f, 0.2f}}, {0, edit_reflection_factor, {0.7f}}}};
+        for (size_t b = 0; b < batches.size(); ++b)
+        {
+            MaterialStore store;
+            store.add(mtl);
+            store.add(mtl);
+            MaterialEditQueue queue(store);
+            Material expected[2] = {mtl, mtl};
+            for (const material_edit &e : batches[b])
+            {
+                queue.push(e);
+                MaterialEditQueue::apply(expected[e.material], e);
+            }
+            queue.process();
+
+            for (u32 id = 0; id < 2; ++id)
+            {
+                if (!near_material(store.get(id), expected[id]))
+                {
+                    cout << "Error: edit queue batch " << b << " material " << id << " -----------------------------------" << endl;
+                    logMaterial(store.get(id));
+                    logMaterial(expected[id]);
+                    return;
+                }
+            }
+        }
+
+        // edits of two UI threads, applied by the compute thread
+        MaterialStore store;
+        store.add(mtl);
+        store.add(mtl);
+        MaterialEditQueue queue(store);
+        u32 reported[2] = {0, 0};
+        queue.on_applied = [&](u32 material, u32 version) { reported[material] = version; };
+        queue.start();
+
+        const u32 count = 2000;
+        std::vector<std::thread> ui;
+        for (u32 id = 0; id < 2; ++id)
+        {
+            ui.emplace_back([&queue, id]()
+            {
+                for (u32 i = 1; i <= count; ++i)
+                    queue.push(id, edit_reflection_factor, 0.8f * float(i) / float(count));
+            });
+        }
+        for (std::thread &t : ui)
+            t.join();
+        queue.flush();
+
+        Material expected = mtl;
+        expected.updateReflectionFactor(0.8f);
+        if (queue.getAppliedCount() != 2 * count || queue.getPushedCount() != 2 * count)
+            cout << "Error: edit queue applied " << queue.getAppliedCount() << " of " << queue.getPushedCount() << " edits" << endl;
+        for (u32 id = 0; id < 2; ++id)
+        {
+            if (!reported[id] || reported[id] != store.getVersion(id) || !near_material(store.get(id), expected))
+            {
+                cout << "Error: edit queue flush material " << id << ", reported version " << reported[id] << ", store version " << store.getVersion(id) << endl;
+                logMaterial(store.get(id));
+                return;
+            }
+        }
+        queue.stop();
+    }
+
+    // std140 rows of a packed material: offsets as the shader declares them, shininess as Phong exponent
+    static void test_material_buffer_pack()
+    {
+        if (offsetof(material_std140, diffuse) != 0 || offsetof(material_std140, shininess) != 12 || offsetof(material_std140, ambient) != 16 ||
+            offsetof(material_std140, opacity) != 28 || offsetof(material_std140, specular) != 32 || offsetof(material_std140, N) != 44)
+        {
+            cout << "Error: material_std140 offsets" << endl;
+            return;
+        }
+
+        Material mtl;
+        mtl.create("", "pack", material_type::metallic, color3f(0.7f, 0.5f, 0.2f), 0.6f, 0.5f, 0.0f, 1.0f, 0.25f);
+        material_std140 packed;
+        MaterialBuffer::pack(mtl, packed);
+        if (packed.shininess < 1.0f || packed.shininess > 128.0f)
+            cout << "Error: material_std140 shininess " << packed.shininess << " is not a Phong exponent" << endl;
+
+        const float *row = reinterpret_cast<const float *>(&packed);
+        const color3f &d = mtl.getDiffuseColor();
+        const color3f &a = mtl.getAmbientColor();
+        const color3f &s = mtl.getSpecularColor();
+        float expected[12] = {d.r, d.g, d.b, 1.0f + 127.0f * mtl.getShininess(), a.r, a.g, a.b, mtl.getOpacity(), s.r, s.g, s.b, mtl.getN()};
+        for (u32 i = 0; i < 12; ++i)
+        {
+            if (row[i] != expected[i])
+            {
+                cout << "Error: material_std140 float " << i << " = " << row[i] << ", expected " << expected[i] << endl;
+                return;
+            }
+        }
+    }
+
+    // photometry loaders: every EULUMDAT isym and IES horizontal symmetry reproduces the distribution at the stored angles
+    static void test_photometry()
+    {
+        // distance [deg] between two C angles
+        auto dist = [](float a, float b) { float d = std::fabs(std::fmod(a - b + 720.0f, 360.0f)); return std::min(d, 360.0f - d); };
+        // I(C, gamma) [cd] with the symmetry of EULUMDAT isym 0..4
+        auto intensity = [&](u32 isym, float c, float g)
+        {
+            float h = 0.0f;
+            switch (isym)
+            {
+            case 0: h = c; break;
+            case 2: h = dist(c, 0.0f); break;
+            case 3: h = dist(c, 90.0f); break;
+            case 4: h = std::min(dist(c, 0.0f), dist(c, 180.0f)); break;
+            }
+            return (g <= 90.0f) ? 1000.0f + 3.0f * h + 2.0f * g : 0.0f;
+        };
+        auto check = [&](const Photometry &ph, u32 isym, const char *name)
+        {
+            for (u32 c = 0; c < 360; c += 15)
+            {
+                for (u32 g = 0; g <= 180; g += 15)
+                {
+                    float expected = intensity(isym, float(c), float(g));
+                    float value = ph.getIntensity(float(c), float(g));
+                    if (std::fabs(value - expected) > 0.01f)
+                    {
+                        cout << "Error: photometry " << name << " isym " << isym << " I(" << c << ", " << g << ") = " << value << ", expected " << expected << endl;
+                        return false;
+                    }
+                }
+            }
+            return true;
+        };
+
+        const u32 mc = 24, ngamma = 19; // C step 15, gamma 0..90 step 5
+        for (u32 isym = 0; isym <= 4; ++isym)
+        {
+            u32 planes = (isym == 0) ? mc : (isym == 1) ? 1 : (isym == 4) ? mc / 4 + 1 : mc / 2 + 1;
+            u32 first = (isym == 3) ? mc * 3 / 4 : 0;
+
+            std::ostringstream ldt;
+            ldt << "Test\n1\n" << isym << "\n" << mc << "\n15\n" << ngamma << "\n5\nreport\nldt luminaire\nnumber\nfile.ldt\ndate\n";
+            ldt << "1000\n1000\n50\n600\n600\n0\n0\n0\n0\n100\n100\n1\n0\n1\n";
+            ldt << "1\nLED\n2000\n4000\n80\n10\n"; // lamp set: 2000 lm
+            for (u32 i = 0; i < 10; ++i)
+                ldt << "0,5\n";
+            for (u32 i = 0; i < mc; ++i)
+                ldt << 15 * i << "\n";
+            for (u32 i = 0; i < ngamma; ++i)
+                ldt << 5 * i << "\n";
+            for (u32 p = 0; p < planes; ++p)
+                for (u32 i = 0; i < ngamma; ++i)
+                    ldt << intensity(isym, float(15 * ((first + p) % mc)), float(5 * i)) / 2.0f << "\n"; // cd/klm
+
+            Photometry ph;
+            if (!ph.loadLDT(ldt.str()) || ph.getFlux() != 2000.0f || ph.getName() != "ldt luminaire")
+            {
+                cout << "Error: photometry ldt isym " << isym << " not loaded" << endl;
+                return;
+            }
+            if (!check(ph, isym, "ldt"))
+                return;
+        }
+
+        // IES horizontal angles: 0, 0..90, 0..180, 90..270, 0..360
+        const u32 ies_sym[5] = {1, 4, 2, 3, 0};
+        const u32 ies_first[5] = {0, 0, 0, 90, 0};
+        const u32 ies_last[5] = {0, 90, 180, 270, 360};
+        for (u32 k = 0; k < 5; ++k)
+        {
+            std::ostringstream ies;
+            ies << "IESNA:LM-63-2002\r\n[TEST] photometry\r\n[LUMCAT] ies catalog\r\nTILT=NONE\r\n";
+            u32 nhoriz = (ies_last[k] - ies_first[k]) / 15 + 1;
+            ies << "1 1000 1 " << ngamma << " " << nhoriz << " 1 2 0.5 0.5 0\r\n1 1 20\r\n";
+            for (u32 i = 0; i < ngamma; ++i)
+                ies << 5 * i << " ";
+            ies << "\r\n";
+            for (u32 c = ies_first[k]; c <= ies_last[k]; c += 15)
+                ies << c << " ";
+            ies << "\r\n";
+            for (u32 c = ies_first[k]; c <= ies_last[k]; c += 15)
+            {
+                for (u32 i = 0; i < ngamma; ++i)
+                    ies << intensity(ies_sym[k], float(c), float(5 * i)) << " ";
+                ies << "\r\n";
+            }
+
+            Photometry ph;
+            if (!ph.loadIES(ies.str()) || ph.getFlux() != 1000.0f || ph.getName().find("ies catalog") == std::string::npos)
+            {
+                cout << "Error: photometry ies " << ies_first[k] << ".." << ies_last[k] << " not loaded" << endl;
+                return;
+            }
+            if (!check(ph, ies_sym[k], "ies"))
+                return;
+        }
+    }
+
+    // material store: versions held by readers survive concurrent publishes, scene coloring reads one store snapshot
+    static void test_material_store(Material mtl, u32 versions = 20000, u32 reader_count = 3)
+    {
+        MaterialStore store;
+        mtl.setReflectionFactor(0.0f);
+        mtl.setRefractive(0.0f);
+        store.add(mtl);
+
+        // every version has reflection factor == refractive == version, a freed and reused node breaks it
+        std::atomic<bool> done{false};
+        std::atomic<u32> errors{0};
+        std::vector<std::thread> readers;
+        for (u32 t = 0; t < reader_count; ++t)
+        {
+            readers.emplace_back([&]()
+            {
+                u32 last = 0;
+                while (!done.load())
+                {
+                    MaterialStore::reader r(store);
+                    const Material &m = r.get(0);
+                    float v = m.getReflectionFactor();
+                    for (u32 k = 0; k < 16; ++k)
+                        std::this_thread::yield();
+                    if (m.getReflectionFactor() != v || m.getRefractive() != v || u32(v) < last)
+                        ++errors;
+                    last = u32(v);
+                }
+            });
+        }
+
+        Material next = mtl;
+        for (u32 v = 1; v <= versions; ++v)
+        {
+            next.setReflectionFactor(float(v));
+            next.setRefractive(float(v));
+            store.publish(0, next);
+        }
+        done = true;
+        for (std::thread &t : readers)
+            t.join();
+
+        store.reclaim();
+        if (errors || store.getVersion(0) != versions + 1 || store.get(0).getRefractive() != float(versions) || store.getRetiredCount())
+        {
+            cout << "Error: material store, " << errors << " torn reads, version " << store.getVersion(0) << ", retired " << store.getRetiredCount() << endl;
+            return;
+        }
+
+        // scene scheduler colors with store materials, not with the mesh handles
+        MaterialStore scene;
+        u32 ids[3];
+        for (u32 i = 0; i < 3; ++i)
+        {
+            Material m;
+            m.create("", "store", material_type::painted, color3f(0.3f + 0.2f * i, 0.5f, 0.7f - 0.2f * i), 0.5f + 0.1f * i, 0.2f, 0.0f, 1.0f, 0.5f);
+            ids[i] = scene.add(m);
+        }
+
+        const u32 sizes[5] = {1, 7000, 300, 12345, 64};
+        std::vector<PuryaMesh *> meshes;
+        std::vector<u32> materials;
+        for (u32 i = 0; i < 5; ++i)
+        {
+            vertex point = vertex();
+            point.vl = color3f(100.0f * (i + 1), 150.0f, 200.0f);
+            point.vd = color3f(20.0f, 10.0f * i, 5.0f);
+            PuryaMesh *mesh = new PuryaMesh();
+            mesh->setPoints(point, sizes[i]);
+            meshes.push_back(mesh);
+            materials.push_back(ids[i % 3]);
+        }
+
+        SceneScheduler scheduler;
+        scheduler.grain = 1000;
+        scheduler.normalizeColor(meshes.data(), materials.data(), u32(meshes.size()), scene, 4);
+
+        bool is_valid = scheduler.getMaterialsCount() == 3;
+        for (u32 i = 0; i < meshes.size(); ++i)
+        {
+            color3f cd = scene.get(materials[i]).getDiffuseSpectrumColor();
+            vertex &p = *(*meshes[i]->getGeometry())[sizes[i] - 1];
+            color4f c, cg;
+            PuryaMesh::colorPoint(p.vl + p.vd, cd, c, cg);
+            is_valid = is_valid && color4f(p.c) == c && color4f(p.cg) == cg;
+            delete meshes[i];
+        }
+        if (!is_valid)
+            cout << "Error: scene scheduler with material store -----------------------------------" << endl;
+    }
+
+    // C ABI: batches of records give the same materials and colors as the C++ classes, errors are status codes
+    static void test_c_api()
+    {
+        dm_library *lib = nullptr;
+        if (dm_library_create(DM_VERSION + (1 << 16), &lib) != DM_ERROR_VERSION || lib || dm_library_create(DM_VERSION, &lib) != DM_OK || !lib)
+        {
+            cout << "Error: dm_library_create" << endl;
+            return;
+        }
+
+        dm_material_params params[3] = {
+            {DM_PAINTED, {0.8f, 0.4f, 0.2f}, 0.6f, 0.1f, 0.0f, 1.0f, 0.3f},
+            {DM_METALLIC, {0.5f, 0.5f, 0.7f}, 0.7f, 0.6f, 0.0f, 1.0f, 0.8f},
+            {DM_TRANSPARENT, {0.9f, 0.9f, 0.9f}, 0.08f, 0.0f, 0.85f, 1.5f, 0.5f}};
+        u32 ids[3] = {};
+        dm_material_params bad = params[0];
+        bad.type = 0;
+        bool is_valid = dm_materials_create(lib, params, 3, ids) == DM_OK && dm_materials_count(lib) == 3 && ids[0] == 0 && ids[2] == 2 &&
+                        dm_materials_create(lib, &bad, 1, nullptr) == DM_ERROR_ARGUMENT && dm_materials_count(lib) == 3;
+
+        params[1].reflection_factor = 0.4f;
+        u32 missing = 3;
+        is_valid = is_valid && dm_materials_update(lib, &ids[1], &params[1], 1) == DM_OK && dm_materials_update(lib, &missing, &params[1], 1) == DM_ERROR_INDEX;
+
+        dm_material_data data[3];
+        is_valid = is_valid && dm_materials_get(lib, ids, 3, data) == DM_OK && dm_materials_get(lib, &missing, 1, data) == DM_ERROR_INDEX;
+        for (u32 i = 0; i < 3 && is_valid; ++i)
+        {
+            Material mtl;
+            material_params p;
+            std::memcpy(&p, &params[i], sizeof(p)); // same layout
+            material_batch::create(p, mtl);
+            material_std140 packed;
+            MaterialBuffer::pack(mtl, packed);
+            is_valid = std::memcmp(&packed, &data[i], sizeof(packed)) == 0 && color3f(data[i].diffuse_spectrum[0], data[i].diffuse_spectrum[1], data[i].diffuse_spectrum[2]) == mtl.getDiffuseSpectrum() &&
+                       data[i].reflection_factor == mtl.getReflectionFactor() && data[i].transparency == mtl.getTransparency();
+        }
+        if (!is_valid)
+        {
+            cout << "Error: dm_materials_* -----------------------------------" << endl;
+            dm_library_destroy(lib);
+            return;
+        }
+
+        // one mesh per material, interleaved rgb
+        const u32 count = 5000;
+        std::vector<float> vl(count * 3), vd(count * 3), c(3 * count * 3), cg(3 * count * 3);
+        for (u32 i = 0; i < count * 3; ++i)
+        {
+            vl[i] = 10.0f + float(i % 997);
+            vd[i] = 0.2f * float(i % 13);
+        }
+        dm_mesh meshes[3];
+        for (u32 m = 0; m < 3; ++m)
+            meshes[m] = dm_mesh{ids[m], count, vl.data(), m == 1 ? nullptr : vd.data(), c.data() + m * count * 3, cg.data() + m * count * 3};
+        if (dm_meshes_color(lib, meshes, 3) != DM_OK)
+            is_valid = false;
+
+        for (u32 m = 0; m < 3 && is_valid; ++m)
+        {
+            Material mtl;
+            material_params p;
+            std::memcpy(&p, &params[m], sizeof(p)); // same layout
+            material_batch::create(p, mtl);
+            for (u32 i = 0; i < count && is_valid; i += 7)
+            {
+                color3f vs(vl[i * 3], vl[i * 3 + 1], vl[i * 3 + 2]);
+                if (meshes[m].vd)
+                    vs += color3f(vd[i * 3], vd[i * 3 + 1], vd[i * 3 + 2]);
+                color4f ce, cge;
+                PuryaMesh::colorPoint(vs, mtl.getDiffuseSpectrum(), ce, cge);
+                const float *cm = meshes[m].c + i * 3, *cgm = meshes[m].cg + i * 3;
+                is_valid = ce == color3f(cm[0], cm[1], cm[2]) && cge == color3f(cgm[0], cgm[1], cgm[2]);
+            }
+        }
+        if (!is_valid)
+            cout << "Error: dm_meshes_color -----------------------------------" << endl;
+        dm_library_destroy(lib);
+    }
+
+    // color cache: hit / miss round trip, keys change with vl and the material, eviction keeps the cache under max_bytes
+    static void test_color_cache(Material mtl, u32 p_count = 1000)
+    {
+        std::error_code ec;
+        std::filesystem::path dir = std::filesystem::temp_directory_path(ec) / "dialux_color_cache_test";
+        std::filesystem::remove_all(dir, ec);
+
+        auto make_mesh = [&](PuryaMesh &mesh, float lx)
+        {
+            vertex point = vertex();
+            mesh.setPoints(point, p_count);
+            for (u32 i = 0; i < p_count; ++i)
+            {
+                vertex &v = *(*mesh.getGeometry())[i];
+                v.vl = color3f(lx + float(i), 2.0f * lx, 300.0f);
+                v.vd = color3f(0.1f * float(i % 10));
+            }
+        };
+        auto colors_equal = [&](PuryaMesh &a, PuryaMesh &b)
+        {
+            for (u32 i = 0; i < p_count; ++i)
+            {
+                vertex &va = *(*a.getGeometry())[i], &vb = *(*b.getGeometry())[i];
+                if (!(va.c == vb.c) || !(va.cg == vb.cg))
+                    return false;
+            }
+            return true;
+        };
+
+        bool is_valid = true;
+        {
+            ColorCache cache(dir.string());
+            PuryaMesh expected, mesh;
+            expected.setMaterial(mtl);
+            mesh.setMaterial(mtl);
+            make_mesh(expected, 100.0f);
+            make_mesh(mesh, 100.0f);
+            expected.normalizeColor();
+
+            u64 key = ColorCache::key(mesh);
+            is_valid = cache.normalizeColor(mesh) && cache.getMisses() == 1 && cache.getHits() == 0 && std::filesystem::exists(cache.path(key)) && colors_equal(mesh, expected);
+
+            make_mesh(mesh, 100.0f); // c / cg cleared
+            is_valid = is_valid && cache.normalizeColor(mesh) && cache.getHits() == 1 && colors_equal(mesh, expected);
+
+            // any input change is a new key
+            (*mesh.getGeometry())[p_count / 2]->vl.g += 1.0f;
+            is_valid = is_valid && ColorCache::key(mesh) != key && cache.normalizeColor(mesh) && cache.getMisses() == 2;
+            make_mesh(mesh, 100.0f);
+            Material other = mtl;
+            other.updateReflectionFactor(mtl.getReflectionFactor() * 0.5f);
+            mesh.setMaterial(other);
+            is_valid = is_valid && ColorCache::key(mesh) != key && cache.normalizeColor(mesh) && cache.getMisses() == 3;
+        }
+        if (!is_valid)
+        {
+            cout << "Error: color cache round trip -----------------------------------" << endl;
+            std::filesystem::remove_all(dir, ec);
+            return;
+        }
+
+        // room for three files, a new instance indexes the three files left above
+        u64 file_size = sizeof(color_cache_header) + u64(p_count) * sizeof(color_cache_record);
+        ColorCache cache(dir.string(), 3 * file_size);
+        cache.evict_to = 1.0f;
+        std::vector<u64> keys;
+        for (u32 m = 0; m < 5; ++m)
+        {
+            PuryaMesh mesh;
+            mesh.setMaterial(mtl);
+            make_mesh(mesh, 1000.0f * float(m + 1));
+            keys.push_back(ColorCache::key(mesh));
+            cache.normalizeColor(mesh);
+        }
+
+        u32 files = 0;
+        for (std::filesystem::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec))
+            ++files;
+        is_valid = files == 3 && cache.getSize() == 3 * file_size && !std::filesystem::exists(cache.path(keys[0])) && !std::filesystem::exists(cache.path(keys[1])) &&
+                   std::filesystem::exists(cache.path(keys[4]));
+
+        cache.clear();
+        is_valid = is_valid && cache.getSize() == 0 && std::filesystem::is_empty(dir, ec);
+        if (!is_valid)
+            cout << "Error: color cache eviction, " << files << " files, " << cache.getSize() << " bytes -----------------------------------" << endl;
+        std::filesystem::remove_all(dir, ec);
+    }
+
+    // material fit: the direct spectra match Material::create, a material's spectra fit back to its parameters
+    static void test_material_fit()
+    {
+        auto near_color = [](const color3f &a, const color3f &b, float eps) { return std::fabs(a.r - b.r) < eps && std::fabs(a.g - b.g) < eps && std::fabs(a.b - b.b) < eps; };
+
+        for (u32 type = material_type::transparent; type <= material_type::painted; ++type)
+        {
+            for (float f = 0.0f; f <= 1.0f; f += 0.15f)
+            {
+                for (float c = 0.0f; c <= 1.0f; c += 0.2f)
+                {
+                    fit_result r;
+                    r.color = color3f(0.9f, 0.3f + 0.5f * c, 0.1f);
+                    r.reflection_factor = f;
+                    r.reflection_coating = c;
+                    r.transparency = (1.0f - f) * c;
+
+                    Material mtl;
+                    material_fit::create(mtl, type, r);
+                    color3f d, s, tr;
+                    material_fit::spectra(type, r, d, s, tr);
+                    if (!near_color(d, mtl.getDiffuseSpectrum(), 1e-5f) || !near_color(s, mtl.getSpecularSpectrum(), 1e-5f) || !near_color(tr, mtl.getTransmissionSpectrum(), 1e-5f))
+                    {
+                        cout << "Error: material fit spectra, type " << type << " ReflF " << f << " ReflC " << c << endl;
+                        logMaterial(mtl);
+                        return;
+                    }
+                }
+            }
+        }
+
+        // colors with a full channel, not desaturated by changeY: the fitted color (chromaticity only) is the original one
+        fit_result known[3];
+        known[0].color = color3f(0.6f, 0.8f, 1.0f);
+        known[0].reflection_factor = 0.08f;
+        known[0].transparency = 0.4f;
+        known[1].color = color3f(1.0f, 0.7f, 0.3f);
+        known[1].reflection_factor = 0.3f;
+        known[1].reflection_coating = 0.7f;
+        known[2].color = color3f(0.2f, 1.0f, 0.4f);
+        known[2].reflection_factor = 0.5f;
+        known[2].reflection_coating = 0.15f;
+
+        fit_target targets[3];
+        for (u32 i = 0; i < 3; ++i)
+        {
+            Material mtl;
+            material_fit::create(mtl, material_type::transparent + i, known[i]);
+            targets[i].type = mtl.getType();
+            targets[i].diffuse = mtl.getDiffuseSpectrum();
+            targets[i].specular = mtl.getSpecularSpectrum();
+            targets[i].transmission = mtl.getTransmissionSpectrum();
+        }
+
+        fit_result fitted[3];
+        material_fit::fit(targets, 3, fitted);
+        for (u32 i = 0; i < 3; ++i)
+        {
+            const fit_result &k = known[i], &r = fitted[i];
+            if (r.error > 1e-8f || std::fabs(r.reflection_factor - k.reflection_factor) > 1e-3f || std::fabs(r.reflection_coating - k.reflection_coating) > 1e-3f ||
+                std::fabs(r.transparency - k.transparency) > 1e-3f || !near_color(r.color, k.color, 1e-3f))
+            {
+                cout << "Error: material fit type " << targets[i].type << ": ReflF " << r.reflection_factor << " ReflC " << r.reflection_coating << " Trans " << r.transparency
+                     << " color " << r.color.r << ", " << r.color.g << ", " << r.color.b << " error " << r.error << endl;
+                return;
+            }
+        }
+    }
+
+    // spectral data: to_rgb(from_rgb(c)) == c, Material spectra project back to its RGB spectra
+    static void test_spectral()
+    {
+        auto near_color = [](const color3f &a, const color3f &b) { return std::fabs(a.r - b.r) < 1e-4f && std::fabs(a.g - b.g) < 1e-4f && std::fabs(a.b - b.b) < 1e-4f; };
+
+        const color3f colors[6] = {color3f(0.0f), color3f(0.5f), color3f(1.0f, 0.0f, 0.0f), color3f(0.1f, 0.8f, 0.3f), color3f(0.02f, 0.05f, 0.9f), color3f(0.9f, 0.7f, 0.1f)};
+        for (const color3f &c : colors)
+        {
+            spectrum<SPECTRAL_BANDS> s;
+            spectral_utils::from_rgb(c, s);
+            color3f rgb = spectral_utils::to_rgb(s);
+            bool gray = c.r == c.g && c.g == c.b; // flat spectrum, same luminance
+            if (!near_color(rgb, c) || (gray && std::fabs(spectral_utils::to_Y(s) - c.r) > 1e-4f))
+            {
+                cout << "Error: spectral round trip " << c.r << ", " << c.g << ", " << c.b << " -> " << rgb.r << ", " << rgb.g << ", " << rgb.b << endl;
+                return;
+            }
+        }
+
+        for (u32 type = material_type::transparent; type <= material_type::painted; ++type)
+        {
+            Material mtl;
+            mtl.create("", "spectral", type, color3f(0.7f, 0.4f, 0.2f), 0.5f, 0.3f, 0.4f, 1.2f, 0.5f);
+            color3f reflectance = color3f(mtl.getDiffuseSpectrum()) + mtl.getSpecularSpectrum();
+            if (!near_color(spectral_utils::to_rgb(mtl.getSpectralReflectance()), reflectance) ||
+                !near_color(spectral_utils::to_rgb(mtl.getSpectralTransmission()), mtl.getTransmissionSpectrum()))
+            {
+                cout << "Error: spectral material type " << type << " -----------------------------------" << endl;
+                logMaterial(mtl);
+                return;
+            }
+        }
+    }
+
+    // light groups: recombined colors match colorPoint of the weighted sum, weights and planes of a wrong size are rejected
+    static void test_light_groups(Material mtl, u32 nu = 50, u32 nv = 26)
+    {
+        const u32 groups = 3;
+        u32 points = nu * nv;
+        LightGroups lg;
+        lg.create(groups, points);
+        for (u32 k = 0; k < groups; ++k)
+            for (u32 i = 0; i < points; ++i)
+                lg.setIlluminance(k, i, color3f(10.0f * (k + 1) + float(i % 100), 50.0f * k + 1.0f, float(i % 7) * (k + 2)));
+
+        const float weights[groups] = {1.0f, 0.0f, 0.35f};
+        PuryaMesh mesh;
+        mesh.setMaterial(mtl);
+        mesh.setPoints(vertex(), points);
+        GridSurface grid;
+        grid.create(vec3f(), vec3f(1.0f, 0.0f, 0.0f), vec3f(0.0f, 1.0f, 0.0f), 0.5f, 0.5f, nu, nv);
+        grid.setMaterial(mtl);
+
+        bool is_valid = lg.normalizeColor(weights, groups, *mesh.getGeometry()) && lg.normalizeColor(weights, groups, grid);
+        color3f cd = mtl.getDiffuseSpectrumColor();
+        for (u32 i = 0; i < points && is_valid; ++i)
+        {
+            color3f vs;
+            for (u32 k = 0; k < groups; ++k)
+                vs += color3f(lg.getPlane(k, 0)[i], lg.getPlane(k, 1)[i], lg.getPlane(k, 2)[i]) * weights[k];
+            color4f c, cg;
+            PuryaMesh::colorPoint(vs, cd, c, cg);
+
+            vertex &v = *(*mesh.getGeometry())[i];
+            const float *gc[4] = {grid.getPlane(grid_plane::plane_c_r), grid.getPlane(grid_plane::plane_c_g), grid.getPlane(grid_plane::plane_c_b), grid.getPlane(grid_plane::plane_cg)};
+            is_valid = std::fabs(v.c.r - c.r) < 1e-5f && std::fabs(v.c.g - c.g) < 1e-5f && std::fabs(v.c.b - c.b) < 1e-5f && std::fabs(v.cg.r - cg.r) < 1e-5f &&
+                       gc[0][i] == v.c.r && gc[1][i] == v.c.g && gc[2][i] == v.c.b && gc[3][i] == v.cg.r;
+        }
+
+        // wrong sizes
+        GridSurface bad_grid;
+        bad_grid.create(vec3f(), vec3f(1.0f, 0.0f, 0.0f), vec3f(0.0f, 1.0f, 0.0f), 0.5f, 0.5f, nu, nv - 1);
+        std::vector<float> plane(points);
+        is_valid = is_valid && !lg.normalizeColor(weights, groups - 1, *mesh.getGeometry()) && !lg.normalizeColor(weights, groups + 1, grid) && !lg.normalizeColor(weights, groups, bad_grid) &&
+                   !lg.normalizeColor(weights, groups, cd, plane.data(), plane.data(), plane.data(), plane.data(), points - 1);
+        if (!is_valid)
+            cout << "Error: light groups -----------------------------------" << endl;
+    }
+
+    // json loader: SSE2 and scalar structural index agree (escapes across 16 byte blocks), trailing data is rejected
+    static void test_json_loader()
+    {
+        // random text over the characters the index cares about
+        u32 seed = 12345;
+        auto next = [&seed]() { seed = seed * 1664525u + 1013904223u; return seed >> 8; };
+        const char alphabet[] = "\"\\{}[]:, a1";
+        std::vector<u32> simd, scalar;
+        for (u32 n = 0; n < 4000; ++n)
+        {
+            std::string text(next() % 200, ' ');
+            for (char &c : text)
+                c = alphabet[next() % (sizeof(alphabet) - 1)];
+            bool a = json_utils::structuralIndex(text.data(), text.size(), simd, true);
+            bool b = json_utils::structuralIndex(text.data(), text.size(), scalar, false);
+            if (a != b || simd != scalar)
+            {
+                cout << "Error: json structural index differs for: " << text << endl;
+                return;
+            }
+        }
+
+        // names with escaped quotes / backslashes shifted over the block boundaries
+        const char *names[4] = {"a\\\"b", "\\\\", "x\\\\\\\"y", "\\\"\\\"\\\\"};
+        const char *decoded[4] = {"a\"b", "\\", "x\\\"y", "\"\"\\"};
+        for (u32 pad = 0; pad < 32; ++pad)
+        {
+            std::string text = "{" + std::string(pad, ' ') + "\"materials\": [";
+            for (u32 i = 0; i < 4; ++i)
+                text += std::string(i ? "," : "") + "{\"name\": \"" + names[i] + "\", \"type\": \"painted\", \"color\": [0.5, 0.5, 0.5], \"reflection_factor\": 0.5}";
+            text += "], \"meshes\": [{\"material\": 3, \"vl\": [1, 2, 3, 4, 5, 6]}]}";
+
+            bool a = json_utils::structuralIndex(text.data(), text.size(), simd, true);
+            bool b = json_utils::structuralIndex(text.data(), text.size(), scalar, false);
+            JsonLoader loader;
+            json_scene scene;
+            bool is_valid = a && b && simd == scalar && loader.parse(text.data(), text.size(), scene) && scene.materials.size() == 4 && scene.meshes.size() == 1 &&
+                            scene.meshes[0].count == 2 && scene.vl[5] == 6.0f && scene.vd[5] == 0.0f;
+            for (u32 i = 0; i < 4 && is_valid; ++i)
+                is_valid = scene.names[i] == decoded[i];
+            if (!is_valid)
+            {
+                cout << "Error: json escapes, pad " << pad << ": " << loader.getError() << endl;
+                return;
+            }
+        }
+
+        // only whitespace may follow the root object
+        const char *texts[4] = {"{\"meshes\": []} \r\n", "{\"meshes\": []} x", "{\"meshes\": []}{}", "{\"meshes\": []}]"};
+        for (u32 i = 0; i < 4; ++i)
+        {
+            JsonLoader loader;
+            json_scene scene;
+            if (loader.parse(texts[i], strlen(texts[i]), scene) != (i == 0))
+            {
+                cout << "Error: json trailing data: " << texts[i] << endl;
+                return;
+            }
+        }
+
+        // file
+        std::error_code ec;
+        std::string path = (std::filesystem::temp_directory_path(ec) / "dialux_json_loader_test.json").string();
+        {
+            std::ofstream out(path, std::ios::binary);
+            out << "{\"materials\": [{\"type\": 2, \"color\": [1, 0.5, 0.2], \"reflection_factor\": 0.5}]}";
+        }
+        JsonLoader loader;
+        json_scene scene;
+        if (!loader.load(path.c_str(), scene) || scene.materials.size() != 1 || scene.materials[0].getType() != material_type::metallic ||
+            loader.load((path + ".missing").c_str(), scene))
+            cout << "Error: json load " << loader.getError() << endl;
+        std::filesystem::remove(path, ec);
+    }
+
+    // texture tint: SSE2 and scalar saturation agree, mean luminance reaches the target, mips keep a flat texture
+    static void test_texture_tint()
+    {
+        auto close_to = [](float a, float b, float eps) { return std::fabs(a - b) <= eps; };
+
+        u32 seed = 777;
+        auto next = [&seed]() { seed = seed * 1664525u + 1013904223u; return float(seed >> 8) / float(1 << 24); };
+        for (u32 count = 0; count < 23; ++count)
+        {
+            std::vector<float> r(count), g(count), b(count);
+            for (u32 i = 0; i < count; ++i)
+            {
+                r[i] = 2.0f * next();
+                g[i] = 2.0f * next();
+                b[i] = i % 5 ? 2.0f * next() : 1.0f;
+            }
+            std::vector<float> r2 = r, g2 = g, b2 = b;
+            texture_utils::saturate(r.data(), g.data(), b.data(), count, true);
+            texture_utils::saturate(r2.data(), g2.data(), b2.data(), count, false);
+            for (u32 i = 0; i < count; ++i)
+            {
+                if (!close_to(r[i], r2[i], 1e-6f) || !close_to(g[i], g2[i], 1e-6f) || !close_to(b[i], b2[i], 1e-6f) || r[i] > 1.0f || g[i] > 1.0f || b[i] > 1.0f)
+                {
+                    cout << "Error: texture saturate SSE2 " << r[i] << " " << g[i] << " " << b[i] << " scalar " << r2[i] << " " << g2[i] << " " << b2[i] << endl;
+                    return;
+                }
+            }
+        }
+
+        // 37x29 (odd sizes, rows not a multiple of the band), no texel clips: mean luminance is the target
+        texture_rgba8 tex;
+        tex.create(37, 29);
+        for (u32 y = 0; y < tex.height; ++y)
+        {
+            u8 *p = tex.row(y);
+            for (u32 x = 0; x < tex.width; ++x, p += 4)
+            {
+                p[0] = u8(60 + (x * 3) % 60);
+                p[1] = u8(40 + (y * 5) % 50);
+                p[2] = u8(50 + (x + y) % 40);
+                p[3] = 255;
+            }
+        }
+        float Y = texture_utils::meanLuminance(tex);
+        texture_utils::tint(tex, 2.0f * Y);
+        if (!close_to(texture_utils::meanLuminance(tex), 2.0f * Y, 0.01f * Y))
+            cout << "Error: texture tint mean " << texture_utils::meanLuminance(tex) << " expected " << 2.0f * Y << endl;
+
+        // clipped texels stay <= white and the mean does not pass the target
+        texture_utils::tint(tex, 0.95f);
+        if (texture_utils::meanLuminance(tex) > 0.95f + 0.01f)
+            cout << "Error: texture tint clipped mean " << texture_utils::meanLuminance(tex) << endl;
+
+        // mips
+        texture_rgba8 flat;
+        flat.create(13, 6);
+        for (u32 i = 0; i < flat.data.size(); ++i)
+            flat.data[i] = (i % 4 == 3) ? 200 : 128;
+        std::vector<texture_rgba8> mips;
+        texture_utils::buildMips(flat, mips);
+        bool is_valid = mips.size() == 3 && mips[0].width == 6 && mips[0].height == 3 && mips[2].width == 1 && mips[2].height == 1;
+        for (const texture_rgba8 &m : mips)
+        {
+            for (u32 i = 0; i < m.data.size() && is_valid; ++i)
+                is_valid = m.data[i] == ((i % 4 == 3) ? 200 : 128);
+        }
+        if (!is_valid)
+            cout << "Error: texture mips " << mips.size() << endl;
+    }
+
+    // daylight series: batched colors match colorPoint per step, sink gets every step once in order, hours above threshold
+    static void test_daylight_series(const Material &mtl)
+    {
+        const u32 steps = 7, points = 2 * DaylightSeries::block_size + 37;
+        color3f cd = mtl.getDiffuseSpectrumColor();
+
+        DaylightSeries series;
+        series.create(steps, points);
+        series.setThreshold(300.0f, 0.5f);
+        std::vector<float> hours(points, 0.0f);
+        for (u32 s = 0; s < steps; ++s)
+        {
+            for (u32 i = 0; i < points; ++i)
+            {
+                color3f E(float(s * 97 + i % 50) * 5.0f, float(s * 61 + i % 30) * 6.0f, float(i % 70) * 7.0f);
+                series.setIlluminance(s, i, E);
+                if (E.sum() / 3.0f >= 300.0f)
+                    hours[i] += 0.5f;
+            }
+        }
+
+        u32 next_step = 0;
+        bool is_valid = true;
+        bool ok = series.normalizeColor(cd, [&](u32 s0, u32 s1, const float *c, const float *cg)
+        {
+            if (s0 != next_step || s1 <= s0 || s1 - s0 > 3)
+                is_valid = false;
+            next_step = s1;
+            for (u32 s = s0; s < s1 && is_valid; ++s)
+            {
+                size_t o = s - s0;
+                for (u32 i = 0; i < points && is_valid; ++i)
+                {
+                    color4f cl, g;
+                    PuryaMesh::colorPoint(color3f(series.getPlane(s, 0)[i], series.getPlane(s, 1)[i], series.getPlane(s, 2)[i]), cd, cl, g);
+                    is_valid = c[(o * 3 + 0) * points + i] == cl.r && c[(o * 3 + 1) * points + i] == cl.g && c[(o * 3 + 2) * points + i] == cl.b &&
+                               cg[o * points + i] == g.r;
+                }
+            }
+        }, 3);
+        is_valid = is_valid && ok;
+        if (!is_valid || next_step != steps)
+        {
+            cout << "Error: daylight series colors, last step " << next_step << endl;
+            return;
+        }
+
+        for (u32 i = 0; i < points; ++i)
+        {
+            if (series.getHoursAbove()[i] != hours[i])
+            {
+                cout << "Error: daylight series hours above at " << i << ": " << series.getHoursAbove()[i] << " expected " << hours[i] << endl;
+                return;
+            }
+        }
+
+        DaylightSeries empty;
+        if (empty.normalizeColor(cd, [](u32, u32, const float *, const float *) {}))
+            cout << "Error: daylight series empty" << endl;
+    }
+
+    // radiosity: closed enclosure conserves energy (all direct flux is absorbed), unknown material fails
+    static void test_radiosity()
+    {
+        Radiosity radiosity;
+        color3f rho[3];
+        for (u32 m = 0; m < 3; ++m)
+        {
+            Material mtl;
+            mtl.create("", "radiosity", material_type::painted, color3f(0.3f + 0.2f * m, 0.5f, 0.7f - 0.2f * m), 0.2f + 0.3f * m, 0.0f, 0.0f, 1.0f, 0.0f);
+            rho[m] = mtl.getDiffuseSpectrum();
+            radiosity.addMaterial(mtl);
+        }
+
+        // enclosure of 40 patches, F_ij = A_j / A (self included): rows sum to 1, A_i F_ij = A_j F_ji
+        const u32 count = 40;
+        std::vector<patch> patches(count);
+        float total = 0.0f;
+        for (u32 i = 0; i < count; ++i)
+        {
+            patches[i].area = 0.5f + float(i % 7);
+            patches[i].material = i % 3;
+            total += patches[i].area;
+        }
+        radiosity.setPatches(patches);
+
+        std::vector<u32> row(count + 1), col;
+        std::vector<float> ff;
+        for (u32 i = 0; i < count; ++i)
+        {
+            row[i] = u32(col.size());
+            for (u32 j = 0; j < count; ++j)
+            {
+                col.push_back(j);
+                ff.push_back(patches[j].area / total);
+            }
+        }
+        row[count] = u32(col.size());
+        radiosity.setFormFactors(row, col, ff);
+        for (u32 i = 0; i < count; ++i)
+            radiosity.setDirect(i, color3f(float(i % 5) * 100.0f, float(i % 3) * 50.0f, 10.0f));
+
+        if (!radiosity.solve(1e-6f, 1000))
+        {
+            cout << "Error: radiosity did not converge, residual " << radiosity.getResidual() << endl;
+            return;
+        }
+
+        // sum A_i * E_i * (1 - rho_i) = sum A_i * vl_i, E = vl + vd
+        double absorbed[3] = {}, direct[3] = {};
+        for (u32 i = 0; i < count; ++i)
+        {
+            color3f vl = radiosity.getDirect(i);
+            color3f E = vl + radiosity.getDiffuse(i);
+            const color3f &r = rho[patches[i].material];
+            absorbed[0] += patches[i].area * E.r * (1.0f - r.r);
+            absorbed[1] += patches[i].area * E.g * (1.0f - r.g);
+            absorbed[2] += patches[i].area * E.b * (1.0f - r.b);
+            direct[0] += patches[i].area * vl.r;
+            direct[1] += patches[i].area * vl.g;
+            direct[2] += patches[i].area * vl.b;
+        }
+        for (u32 c = 0; c < 3; ++c)
+        {
+            if (std::fabs(absorbed[c] - direct[c]) > 1e-3 * direct[c])
+            {
+                cout << "Error: radiosity energy channel " << c << ": absorbed " << absorbed[c] << " direct " << direct[c] << endl;
+                return;
+            }
+        }
+
+        patches[count - 1].material = 3;
+        radiosity.setPatches(patches);
+        if (radiosity.solve())
+            cout << "Error: radiosity solved with an unknown material" << endl;
+    }
+
+    // view luminance: without light directions the light comes along the normal (same result as explicit lx = nx),
+    // checked against the formula per point, views behind the surface get the diffuse term only
+    static void test_view_luminance()
+    {
+        Material mtl;
+        mtl.create("", "view", material_type::metallic, color3f(0.9f, 0.6f, 0.3f), 0.6f, 0.7f, 0.0f, 1.0f, 0.3f);
+        if (color3f(mtl.getSpecularSpectrum()).isEmpty())
+        {
+            cout << "Error: view luminance material without specular" << endl;
+            return;
+        }
+
+        const u32 count = ViewLuminance::block_size + 45;
+        std::vector<float> px(count), py(count), pz(count, 0.0f), nx(count), ny(count), nz(count);
+        std::vector<color3f> vl(count), vd(count);
+        for (u32 i = 0; i < count; ++i)
+        {
+            px[i] = float(i % 17) * 0.3f;
+            py[i] = float(i / 17) * 0.3f;
+            vec3f n(0.1f * float(i % 3), -0.1f * float(i % 2), 1.0f);
+            n = n / n.length();
+            nx[i] = n.x;
+            ny[i] = n.y;
+            nz[i] = n.z;
+            vl[i] = color3f(100.0f + i, 200.0f, 50.0f);
+            vd[i] = color3f(20.0f, 10.0f, 5.0f + i);
+        }
+
+        view_points pts;
+        pts.count = count;
+        pts.px = px.data(), pts.py = py.data(), pts.pz = pz.data();
+        pts.nx = nx.data(), pts.ny = ny.data(), pts.nz = nz.data();
+        pts.vl = vl.data(), pts.vd = vd.data();
+
+        const vec3f views[3] = {vec3f(2.0f, 1.0f, 3.0f), vec3f(0.5f, 0.5f, 0.8f), vec3f(1.0f, 2.0f, -2.0f)};
+        ViewLuminance view;
+        view.setMaterial(mtl);
+        std::vector<float> lum(3 * 3 * count), lum_l(3 * 3 * count);
+        view.compute(pts, views, 3, lum.data());
+
+        pts.lx = nx.data(), pts.ly = ny.data(), pts.lz = nz.data();
+        view.compute(pts, views, 3, lum_l.data());
+        if (lum != lum_l)
+        {
+            cout << "Error: view luminance, null light direction differs from the normal" << endl;
+            return;
+        }
+
+        color3f cd = mtl.getDiffuseSpectrum(), cs = mtl.getSpecularSpectrum();
+        float n = material_utils::to_phong_exponent(mtl.getShininess());
+        for (u32 v = 0; v < 3; ++v)
+        {
+            for (u32 i = 0; i < count; ++i)
+            {
+                vec3f e(views[v].x - px[i], views[v].y - py[i], views[v].z - pz[i]);
+                float cos_a = e.dot(vec3f(nx[i], ny[i], nz[i])) / e.length();
+                float spec = cos_a > 0.0f ? (n + 2.0f) / (2.0f * mesh_utils::PI) * std::pow(cos_a, n) : 0.0f;
+                float expected[3] = {cd.r * (vl[i].r + vd[i].r) / mesh_utils::PI + cs.r * vl[i].r * spec,
+                                     cd.g * (vl[i].g + vd[i].g) / mesh_utils::PI + cs.g * vl[i].g * spec,
+                                     cd.b * (vl[i].b + vd[i].b) / mesh_utils::PI + cs.b * vl[i].b * spec};
+                for (u32 ch = 0; ch < 3; ++ch)
+                {
+                    float got = lum[(size_t(v) * 3 + ch) * count + i];
+                    if (std::fabs(got - expected[ch]) > 1e-3f * std::max(1.0f, expected[ch]))
+                    {
+                        cout << "Error: view luminance view " << v << " point " << i << ": " << got << " expected " << expected[ch] << endl;
+                        return;
+                    }
+                }
+            }
+        }
+    }
+
+    // material catalog: k-d tree nearest / range give the brute force results, type filter
+    static void test_material_catalog()
+    {
+        u32 seed = 4242;
+        auto next = [&seed]() { seed = seed * 1664525u + 1013904223u; return float(seed >> 8) / float(1 << 24); };
+
+        const u32 types[3] = {material_type::transparent, material_type::metallic, material_type::painted};
+        MaterialCatalog catalog;
+        for (u32 i = 0; i < 600; ++i)
+        {
+            Material mtl;
+            mtl.create("", "catalog", types[i % 3], color3f(next(), next(), next()), 0.05f + 0.8f * next(), 0.3f, 0.5f, 1.2f, 0.5f);
+            catalog.add(MaterialHandle(mtl));
+        }
+        catalog.build();
+
+        // brute force over the catalog with the same keys
+        auto distance = [&](const catalog_query &q, u32 i)
+        {
+            const Material &mtl = catalog.get(i).get();
+            float a[4], b[4];
+            catalog.key(q.color, q.reflection_factor, a);
+            catalog.key(mtl.getColor(), mtl.getReflectionFactor(), b);
+            float d = 0.0f;
+            for (u32 c = 0; c < 4; ++c)
+                d += (a[c] - b[c]) * (a[c] - b[c]);
+            return std::sqrt(d);
+        };
+
+        const u32 k = 5;
+        catalog_match out[k];
+        std::vector<catalog_match> in_range;
+        for (u32 n = 0; n < 200; ++n)
+        {
+            catalog_query q;
+            q.type = (n % 4 == 3) ? u32(material_type::undefined) : types[n % 4];
+            q.color = color3f(next(), next(), next());
+            q.reflection_factor = next();
+
+            std::vector<catalog_match> all;
+            for (u32 i = 0; i < catalog.getCount(); ++i)
+            {
+                if (q.type == material_type::undefined || catalog.get(i).get().getType() == q.type)
+                    all.push_back({i, distance(q, i)});
+            }
+            std::sort(all.begin(), all.end(), [](const catalog_match &a, const catalog_match &b) { return a.distance < b.distance; });
+
+            u32 found = catalog.nearest(q, out, k);
+            bool is_valid = found == std::min(k, u32(all.size()));
+            for (u32 i = 0; i < found && is_valid; ++i)
+                is_valid = std::fabs(out[i].distance - all[i].distance) <= 1e-3f * std::max(1.0f, all[i].distance) &&
+                           (q.type == material_type::undefined || catalog.get(out[i].index).get().getType() == q.type);
+
+            float radius = all.size() > 20 ? all[20].distance : 0.0f;
+            u32 expected = 0;
+            for (const catalog_match &m : all)
+                expected += m.distance <= radius * (1.0f - 1e-4f) ? 1 : 0;
+            u32 count = catalog.range(q, radius * (1.0f - 1e-4f), in_range);
+            is_valid = is_valid && count == expected;
+
+            if (!is_valid)
+            {
+                cout << "Error: material catalog query " << n << ": found " << found << ", range " << count << " expected " << expected << endl;
+                return;
+            }
+        }
+
+        // batch: unused slots are empty
+        catalog_query q[2];
+        q[0].type = material_type::painted;
+        q[1].type = material_type::painted + 1;
+        std::vector<catalog_match> batch(2 * k);
+        catalog.nearest(q, 2, batch.data(), k);
+        if (batch[k - 1].index == ~0u || batch[k].index != ~0u)
+            cout << "Error: material catalog batch" << endl;
+    }
+
+    // ordered pipeline: items reach write in read order although workers finish out of order,
+    // read never runs ahead of write by capacity items, a slow writer fills the pipeline
+    static void test_ordered_pipeline()
+    {
+        const u32 count = 60, workers = 3, capacity = 4;
+        std::atomic<u32> written{0};
+        u32 read = 0, max_ahead = 0;
+        std::vector<u32> order;
+        bool is_valid = true;
+
+        parallel_utils::ordered_pipeline<u32>(
+            [&](u32 &item)
+            {
+                if (read == count)
+                    return false;
+                u32 ahead = read - written.load();
+                max_ahead = std::max(max_ahead, ahead);
+                is_valid = is_valid && ahead < capacity;
+                item = read++;
+                return true;
+            },
+            [](u32 &item) { std::this_thread::sleep_for(std::chrono::microseconds(200 * (2 - item % 3))); },
+            [&](u32 &item)
+            {
+                std::this_thread::sleep_for(std::chrono::microseconds(300));
+                order.push_back(item);
+                written.fetch_add(1);
+            },
+            workers, capacity);
+
+        for (u32 i = 0; i < order.size() && is_valid; ++i)
+            is_valid = order[i] == i;
+        if (!is_valid || order.size() != count || max_ahead != capacity - 1)
+            cout << "Error: ordered pipeline, written " << order.size() << ", max read ahead " << max_ahead << endl;
+
+        // empty input
+        u32 calls = 0;
+        parallel_utils::ordered_pipeline<u32>([](u32 &) { return false; }, [](u32 &) {}, [&](u32 &) { ++calls; });
+        if (calls)
+            cout << "Error: ordered pipeline, empty input wrote " << calls << endl;
+    }
+
+    // color pipeline: chunks reach the sink in push order with the colors of PuryaMesh::normalizeColor
+    static void test_color_pipeline()
+    {
+        Material mtl[2];
+        mtl[0].create("", "pipeline0", material_type::painted, color3f(0.8f, 0.3f, 0.1f), 0.7f, 0.2f, 0.0f, 1.0f, 0.5f);
+        mtl[1].create("", "pipeline1", material_type::metallic, color3f(0.2f, 0.4f, 0.9f), 0.5f, 0.8f, 0.0f, 1.0f, 0.5f);
+
+        const u32 sizes[2] = {5000, 1234};
+        PuryaMesh expected[2], meshes[2];
+        for (u32 m = 0; m < 2; ++m)
+        {
+            expected[m].setMaterial(mtl[m]);
+            expected[m].setPoints(vertex(), sizes[m]);
+            meshes[m].setPoints(vertex(), sizes[m]);
+            for (u32 i = 0; i < sizes[m]; ++i)
+            {
+                vertex &v = *(*expected[m].getGeometry())[i];
+                v.vl = color3f(float(i % 400) * 2.0f, float(i % 90) * 7.0f + m, 300.0f);
+                v.vd = color3f(m ? 0.0f : float(i % 13) * 20.0f, m ? 0.0f : 40.0f, 0.0f); // mesh 1 is pushed without vd
+            }
+            expected[m].normalizeColor();
+        }
+
+        // chunks of both meshes interleaved, sizes not a multiple of anything
+        struct chunk_range
+        {
+            u32 mesh, first, count;
+        };
+        std::vector<chunk_range> pushed;
+        u32 first[2] = {0, 0};
+        for (u32 n = 0; first[0] < sizes[0] || first[1] < sizes[1]; ++n)
+        {
+            u32 m = (first[n % 2] < sizes[n % 2]) ? n % 2 : 1 - n % 2;
+            u32 count = std::min(sizes[m] - first[m], 97 + 131 * (n % 5));
+            pushed.push_back({m, first[m], count});
+            first[m] += count;
+        }
+
+        u32 next_sink = 0;
+        bool is_valid = true;
+        {
+            ColorPipeline pipeline([&](const color_chunk &chunk)
+            {
+                is_valid = is_valid && next_sink < pushed.size() && pushed[next_sink].mesh == chunk.mesh && pushed[next_sink].first == chunk.first;
+                ++next_sink;
+                ColorPipeline::toGeometry(*meshes[chunk.mesh].getGeometry())(chunk);
+            }, 3, 2);
+
+            std::vector<color3f> vl, vd;
+            for (const chunk_range &r : pushed)
+            {
+                vl.clear();
+                vd.clear();
+                for (u32 i = r.first; i < r.first + r.count; ++i)
+                {
+                    vertex &v = *(*expected[r.mesh].getGeometry())[i];
+                    vl.push_back(v.vl);
+                    vd.push_back(v.vd);
+                }
+                pipeline.push(r.mesh, r.first, mtl[r.mesh], vl.data(), r.mesh ? nullptr : vd.data(), r.count);
+            }
+            pipeline.finish();
+        }
+
+        is_valid = is_valid && next_sink == pushed.size();
+        for (u32 m = 0; m < 2 && is_valid; ++m)
+        {
+            for (u32 i = 0; i < sizes[m] && is_valid; ++i)
+            {
+                vertex &a = *(*expected[m].getGeometry())[i], &b = *(*meshes[m].getGeometry())[i];
+                is_valid = color4f(a.c) == b.c && color4f(a.cg) == b.cg;
+            }
+        }
+        if (!is_valid)
+            cout << "Error: color pipeline, " << next_sink << " of " << pushed.size() << " chunks" << endl;
+    }
+
+    // scene scheduler: mixed mesh sizes (empty, smaller and larger than the grain) get the colors of per-mesh normalizeColor
+    static void test_scene_scheduler()
+    {
+        MaterialHandle handles[3];
+        for (u32 m = 0; m < 3; ++m)
+        {
+            Material mtl;
+            mtl.create("", "scheduler", material_type::painted, color3f(0.3f + 0.2f * m, 0.5f, 0.7f - 0.2f * m), 0.4f + 0.2f * m, 0.2f, 0.0f, 1.0f, 0.5f);
+            handles[m] = MaterialHandle(mtl);
+        }
+
+        const u32 sizes[9] = {0, 1, 999, 1000, 1001, 12345, 3, 2500, 0};
+        const u32 count = 9;
+        u32 total = 0;
+        std::vector<PuryaMesh *> meshes, expected;
+        for (u32 m = 0; m < count; ++m)
+        {
+            for (u32 k = 0; k < 2; ++k)
+            {
+                PuryaMesh *mesh = new PuryaMesh();
+                mesh->setMaterial(handles[m % 3]);
+                mesh->setPoints(vertex(), sizes[m]);
+                for (u32 i = 0; i < sizes[m]; ++i)
+                {
+                    vertex &v = *(*mesh->getGeometry())[i];
+                    v.vl = color3f(float(i % 300) * 3.0f + m, float(i % 70) * 9.0f, 150.0f);
+                    v.vd = color3f(10.0f * m, float(i % 11) * 4.0f, 5.0f);
+                }
+                (k ? expected : meshes).push_back(mesh);
+            }
+            expected.back()->normalizeColor();
+            total += sizes[m];
+        }
+
+        const u32 threads[3] = {1, 2, 5};
+        bool is_valid = true;
+        for (u32 t = 0; t < 3 && is_valid; ++t)
+        {
+            SceneScheduler scheduler;
+            scheduler.grain = 1000;
+            scheduler.normalizeColor(meshes, threads[t]);
+            is_valid = scheduler.getMaterialsCount() == 3 && scheduler.getTasksCount() == (total + scheduler.grain - 1) / scheduler.grain;
+
+            for (u32 m = 0; m < count && is_valid; ++m)
+            {
+                for (u32 i = 0; i < sizes[m] && is_valid; ++i)
+                {
+                    vertex &a = *(*expected[m]->getGeometry())[i], &b = *(*meshes[m]->getGeometry())[i];
+                    is_valid = color4f(a.c) == b.c && color4f(a.cg) == b.cg;
+                    b.c = color4f();
+                    b.cg = color4f();
+                }
+            }
+            if (!is_valid)
+                cout << "Error: scene scheduler, " << threads[t] << " threads, " << scheduler.getTasksCount() << " tasks" << endl;
+        }
+
+        for (u32 m = 0; m < count; ++m)
+        {
+            delete meshes[m];
+            delete expected[m];
+        }
+    }
+
+    // material preview: curves are cached per handle / field / count until the handle publishes a new version
+    static void test_material_preview()
+    {
+        Material mtl;
+        mtl.create("", "preview", material_type::painted, color3f(0.8f, 0.4f, 0.2f), 0.6f, 0.3f, 0.0f, 1.0f, 0.5f);
+        MaterialHandle handle(mtl), other(mtl);
+
+        auto same = [](const preview_curve &a, const preview_curve &b)
+        {
+            if (a.field != b.field || a.samples.size() != b.samples.size())
+                return false;
+            for (size_t i = 0; i < a.samples.size(); ++i)
+            {
+                const preview_sample &x = a.samples[i], &y = b.samples[i];
+                if (x.value != y.value || x.reflection_factor != y.reflection_factor || x.reflection_coating != y.reflection_coating ||
+                    !(color3f(x.diffuse_spectrum) == y.diffuse_spectrum) || !(color3f(x.specular_spectrum) == y.specular_spectrum) ||
+                    memcmp(&x.graphics, &y.graphics, sizeof(material_std140)))
+                    return false;
+            }
+            return true;
+        };
+
+        MaterialPreview preview;
+        preview_curve expected;
+        MaterialPreview::compute(handle.get(), edit_reflection_factor, 32, expected);
+
+        bool is_valid = same(preview.curve(handle, edit_reflection_factor, 32), expected) && preview.getMisses() == 1 && preview.getHits() == 0;
+        is_valid = is_valid && same(preview.curve(handle, edit_reflection_factor, 32), expected) && preview.getMisses() == 1 && preview.getHits() == 1;
+        const preview_sample &last = preview.sample(handle, edit_reflection_factor, 0.9f, 32);
+        is_valid = is_valid && last.value == expected.samples.back().value && last.reflection_factor == expected.samples.back().reflection_factor;
+        is_valid = is_valid && preview.sample(handle, edit_reflection_factor, 0.0f, 32).value == expected.samples[0].value;
+        is_valid = is_valid && preview.getMisses() == 1 && preview.getHits() == 3;
+        if (!is_valid)
+        {
+            cout << "Error: material preview hit, misses " << preview.getMisses() << " hits " << preview.getHits() << endl;
+            return;
+        }
+
+        // new version: recomputed from the edited material
+        handle.edit([](Material &m) { return m.updateReflectionFactor(0.3f); });
+        MaterialPreview::compute(handle.get(), edit_reflection_factor, 32, expected);
+        is_valid = same(preview.curve(handle, edit_reflection_factor, 32), expected) && preview.getMisses() == 2 && preview.getHits() == 3;
+        is_valid = is_valid && same(preview.curve(handle, edit_reflection_factor, 32), expected) && preview.getHits() == 4;
+        if (!is_valid)
+        {
+            cout << "Error: material preview version, misses " << preview.getMisses() << " hits " << preview.getHits() << endl;
+            return;
+        }
+
+        // other field, other count, other handle of an equal material: separate curves
+        preview.curve(handle, edit_reflection_coating, 32);
+        preview.curve(handle, edit_reflection_factor, 16);
+        preview.curve(other, edit_reflection_factor, 32);
+        is_valid = preview.getMisses() == 5 && preview.getHits() == 4;
+
+        // least recently used curve is replaced, removed curves are recomputed
+        preview.max_curves = 4;
+        preview.curve(handle, edit_reflection_factor, 32); // hit, the coating curve is the oldest now
+        preview.curve(other, edit_transparency, 32);       // replaces the coating curve
+        preview.curve(handle, edit_reflection_coating, 32);
+        is_valid = is_valid && preview.getMisses() == 7 && preview.getHits() == 5;
+        preview.remove(other);
+        preview.curve(other, edit_reflection_factor, 32);
+        is_valid = is_valid && preview.getMisses() == 8;
+        if (!is_valid)
+            cout << "Error: material preview cache, misses " << preview.getMisses() << " hits " << preview.getHits() << endl;
+    }
+
+    // material buffer: dirty ranges merge within merge_gap in any order, removed slots are reused, sync repacks edited handles only
+    static void test_material_buffer()
+    {
+        std::vector<MaterialHandle> handles;
+        for (u32 i = 0; i < 24; ++i)
+        {
+            Material mtl;
+            mtl.create("", "buffer", material_type::painted, color3f(0.04f * i, 0.5f, 0.9f - 0.03f * i), 0.1f + 0.03f * i, 0.2f, 0.0f, 1.0f, 0.5f);
+            handles.push_back(MaterialHandle(mtl));
+        }
+
+        auto ranges_are = [](const MaterialBuffer &buffer, std::vector<std::pair<u32, u32>> expected) { return buffer.getDirtyRanges() == expected; };
+        auto packed = [](const MaterialBuffer &buffer, u32 index, const Material &mtl)
+        {
+            material_std140 expected;
+            MaterialBuffer::pack(mtl, expected);
+            return !memcmp(&buffer[index], &expected, sizeof(material_std140));
+        };
+
+        MaterialBuffer buffer;
+        buffer.merge_gap = 2;
+        for (u32 i = 0; i < 20; ++i)
+            buffer.add(handles[i]);
+        bool is_valid = buffer.getCount() == 20 && buffer.getSize() == 20 * sizeof(material_std140) && ranges_are(buffer, {{0, 20}});
+        buffer.clearDirty();
+        is_valid = is_valid && !buffer.isDirty();
+
+        // out of order, bridged by the gap, adjacent, overlapping
+        buffer.update(10, handles[10]);
+        buffer.update(5, handles[5]);
+        is_valid = is_valid && ranges_are(buffer, {{5, 6}, {10, 11}});
+        buffer.update(8, handles[8]); // 2 from both neighbours: one range
+        is_valid = is_valid && ranges_are(buffer, {{5, 11}});
+        buffer.update(15, handles[15]);
+        buffer.update(11, handles[11]); // adjacent
+        buffer.update(7, handles[7]);   // inside
+        buffer.update(0, handles[0]);
+        buffer.update(19, handles[19]);
+        is_valid = is_valid && ranges_are(buffer, {{0, 1}, {5, 12}, {15, 16}, {19, 20}});
+        buffer.update(17, handles[17]); // joins the last two
+        is_valid = is_valid && ranges_are(buffer, {{0, 1}, {5, 12}, {15, 20}});
+        if (!is_valid)
+        {
+            cout << "Error: material buffer dirty ranges" << endl;
+            return;
+        }
+        buffer.clearDirty();
+
+        // removed slots are zeroed and reused, last removed first
+        buffer.remove(3);
+        buffer.remove(17);
+        material_std140 zero = material_std140();
+        is_valid = ranges_are(buffer, {{3, 4}, {17, 18}}) && !memcmp(&buffer[17], &zero, sizeof(zero));
+        is_valid = is_valid && buffer.add(handles[20]) == 17 && buffer.add(handles[21]) == 3 && buffer.add(handles[22]) == 20 && buffer.getCount() == 21;
+        is_valid = is_valid && packed(buffer, 17, handles[20].get()) && packed(buffer, 3, handles[21].get()) && ranges_are(buffer, {{3, 4}, {17, 21}});
+        if (!is_valid)
+        {
+            cout << "Error: material buffer slot reuse" << endl;
+            return;
+        }
+        buffer.clearDirty();
+
+        // only edited handles are repacked, the handle of a removed slot is not read
+        handles[2].edit([](Material &m) { return m.updateReflectionFactor(0.7f); });
+        handles[12].edit([](Material &m) { return m.updateReflectingCoating(0.9f); });
+        handles[17].edit([](Material &m) { return m.updateReflectionFactor(0.5f); });
+        is_valid = buffer.sync() == 2 && ranges_are(buffer, {{2, 3}, {12, 13}}) && packed(buffer, 2, handles[2].get()) && packed(buffer, 12, handles[12].get()) &&
+                   packed(buffer, 17, handles[20].get());
+        buffer.clearDirty();
+        is_valid = is_valid && buffer.sync() == 0 && !buffer.isDirty();
+        if (!is_valid)
+            cout << "Error: material buffer sync" << endl;
+    }
+
+    // material service over raw HTTP: CORS headers only for the allowed origin, other origins are refused,
+    // HTTP/1.0 connections are closed unless they ask for keep-alive
+    static void test_material_service_http()
+    {
+        MaterialService service;
+        service.idle_timeout = 400;
+        service.allowed_origin = "http://localhost:8080";
+        if (!service.start(0, 1))
+        {
+            cout << "Error: material service http start -----------------------------------" << endl;
+            return;
+        }
+
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<unsigned short>(service.getPort()));
+        inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+
+        // sends one request, returns the response head and body ("" if the connection closed first)
+        auto exchange = [](service_utils::socket_t s, const std::string &request)
+        {
+            std::string response;
+            if (!service_utils::sendAll(s, request.data(), request.size()))
+                return response;
+            char chunk[4096];
+            size_t end, length = 0;
+            while ((end = response.find("\r\n\r\n")) == std::string::npos || response.size() < end + 4 + length)
+            {
+                int n = recv(s, chunk, sizeof(chunk), 0);
+                if (n <= 0)
+                    return std::string();
+                response.append(chunk, n);
+                size_t cl = response.find("Content-Length: ");
+                if (cl != std::string::npos)
+                    length = size_t(std::strtoull(response.c_str() + cl + 16, nullptr, 10));
+            }
+            return response;
+        };
+        auto open = [&]()
+        {
+            service_utils::socket_t s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+            if (connect(s, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0)
+            {
+                service_utils::closeSocket(s);
+                return service_utils::invalid_socket;
+            }
+            service_utils::setTimeout(s, 2000);
+            return s;
+        };
+        auto has = [](const std::string &text, const char *part) { return text.find(part) != std::string::npos; };
+
+        const std::string get = "POST /nothing HTTP/1.1\r\nHost: localhost\r\nContent-Length: 0\r\n";
+        service_utils::socket_t s = open();
+        std::string plain = exchange(s, get + "\r\n");
+        std::string allowed = exchange(s, get + "Origin: http://localhost:8080\r\n\r\n");
+        std::string preflight = exchange(s, "OPTIONS /materials HTTP/1.1\r\nHost: localhost\r\nOrigin: http://localhost:8080\r\nContent-Length: 0\r\n\r\n");
+        std::string other = exchange(s, get + "Origin: http://evil.example\r\nConnection: close\r\n\r\n");
+        service_utils::closeSocket(s);
+
+        bool is_valid = has(plain, "HTTP/1.1 404") && !has(plain, "Access-Control-Allow-Origin") && has(allowed, "HTTP/1.1 404") &&
+                        has(allowed, "Access-Control-Allow-Origin: http://localhost:8080\r\n") && has(preflight, "HTTP/1.1 204") &&
+                        has(preflight, "Access-Control-Allow-Methods: POST, OPTIONS") && has(other, "HTTP/1.1 403") && !has(other, "Access-Control-Allow-Origin");
+        if (!is_valid)
+            cout << "Error: material service cors ------------------------------------------" << endl;
+
+        char byte;
+        s = open();
+        std::string http10 = exchange(s, "POST /nothing HTTP/1.0\r\nContent-Length: 0\r\n\r\n");
+        is_valid = has(http10, "HTTP/1.1 404") && has(http10, "Connection: close") && recv(s, &byte, 1, 0) == 0;
+        service_utils::closeSocket(s);
+
+        s = open();
+        const std::string keep = "POST /nothing HTTP/1.0\r\nConnection: Keep-Alive\r\nContent-Length: 0\r\n\r\n";
+        std::string first = exchange(s, keep), second = exchange(s, keep);
+        is_valid = is_valid && has(first, "Connection: keep-alive") && has(second, "HTTP/1.1 404");
+        service_utils::closeSocket(s);
+
+        service.stop();
+        if (!is_valid)
+            cout << "Error: material service http/1.0 keep-alive ------------------------------------------" << endl;
+    }
+
 }
@@ -1,8 +1,12 @@
+#pragma once
+
 #include <math.h>
 #include <iostream>
 using namespace std;
 
 typedef unsigned int u32;
+typedef unsigned char u8;
+typedef unsigned long long u64;
 
 struct color3f
 {
@@ -212,6 +216,44 @@ public:
 
 typedef color3f color4f;
 
+struct vec3f
+{
+    float x, y, z;
+
+    vec3f() : x(0.0f), y(0.0f), z(0.0f) {}
+
+    vec3f(float x, float y, float z) : x(x), y(y), z(z) {}
+
+    void set(float X, float Y, float Z)
+    {
+        x = X;
+        y = Y;
+        z = Z;
+    }
+
+    void show()
+    {
+        cout << "(" << x << ", " << y << ", " << z << ")";
+    }
+
+    vec3f operator+(const vec3f &v) const { return vec3f(x + v.x, y + v.y, z + v.z); }
+    vec3f operator-(const vec3f &v) const { return vec3f(x - v.x, y - v.y, z - v.z); }
+    vec3f operator*(const float &scalar) const { return vec3f(x * scalar, y * scalar, z * scalar); }
+    vec3f operator/(const float &scalar) const { return vec3f(x / scalar, y / scalar, z / scalar); }
+
+    float dot(const vec3f &v) const { return x * v.x + y * v.y + z * v.z; }
+
+    vec3f cross(const vec3f &v) const { return vec3f(y * v.z - z * v.y, z * v.x - x * v.z, x * v.y - y * v.x); }
+
+    float length() const { return sqrt(dot(*this)); }
+
+    vec3f getNormalize() const
+    {
+        float len = length();
+        return (len > 0.0f) ? (*this) / len : vec3f();
+    }
+};
+
 struct vertex3f
 {
 
@@ -223,6 +265,8 @@ struct vertex3f
     color3f vd; // диффузная состовляющая освещенности
     color3f vs; // суммараная освещенность
 
+    vec3f p; // положение расчетной точки
+
     void show()
     {
         cout << "cg";
@@ -254,6 +298,7 @@ struct vertex3f
         vl = v.vl;
         vd = v.vd;
         vs = vd + vl;
+        p = v.p;
         c = v.c;
         cg = v.cg;
         cr = v.cr;